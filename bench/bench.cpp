@@ -0,0 +1,421 @@
+#include "bc_encoder.hpp"
+#include "engine.hpp"
+#include "filter.hpp"
+#include "texture.hpp"
+
+#include <nvtt/nvtt.h>
+#include <omp.h>
+#include <wx/init.h>
+#include <wx/mstream.h>
+#include <wx/stream.h>
+#include <wx/zipstrm.h>
+#include <wx/datstrm.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// Counts allocations made through this binary's operator new. nvtt allocates
+// inside its own DLL, so its internal buffers do not show up here.
+static std::atomic<size_t> allocation_count = 0;
+
+void *operator new(size_t size)
+{
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+
+	if (auto ptr = std::malloc(size ? size : 1))
+		return ptr;
+
+	throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+struct Result {
+	double ns_per_op;
+	double bytes_per_second;
+	double allocations_per_op;
+};
+
+static std::string filter;
+
+static void Report(const std::string &name, const Result &result)
+{
+	std::printf("%-48s %14.0f ns/op %10.1f MiB/s %10.1f allocs/op\n", name.c_str(),
+		    result.ns_per_op, result.bytes_per_second / (1024.0 * 1024.0),
+		    result.allocations_per_op);
+}
+
+// Runs op until at least min_time has elapsed, after one untimed warm-up
+static void Bench(const std::string &name, size_t bytes_per_op, const std::function<void()> &op,
+		  std::chrono::duration<double> min_time = std::chrono::milliseconds(500))
+{
+	if (!filter.empty() && name.find(filter) == std::string::npos)
+		return;
+
+	op();
+
+	size_t iterations = 0;
+	auto allocations = allocation_count.load();
+	auto start = std::chrono::steady_clock::now();
+
+	std::chrono::duration<double> elapsed{};
+	while (iterations < 3 || elapsed < min_time) {
+		op();
+
+		++iterations;
+		elapsed = std::chrono::steady_clock::now() - start;
+	}
+
+	auto seconds = elapsed.count();
+
+	Result result;
+	result.ns_per_op = seconds * 1e9 / iterations;
+	result.bytes_per_second = static_cast<double>(bytes_per_op) * iterations / seconds;
+	result.allocations_per_op =
+		static_cast<double>(allocation_count.load() - allocations) / iterations;
+
+	Report(name, result);
+}
+
+static nvtt::Surface MakeSurface(int width, int height)
+{
+	std::mt19937 rng{1234};
+	std::uniform_int_distribution<int> noise{0, 31};
+
+	std::vector<uint8_t> bgra(static_cast<size_t>(width) * height * 4);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			auto texel = &bgra[(static_cast<size_t>(y) * width + x) * 4];
+
+			texel[0] = static_cast<uint8_t>(x * 255 / width) ^ noise(rng);
+			texel[1] = static_cast<uint8_t>(y * 255 / height) ^ noise(rng);
+			texel[2] = static_cast<uint8_t>((x + y) * 127 / width) ^ noise(rng);
+			texel[3] = static_cast<uint8_t>(255 - noise(rng));
+		}
+	}
+
+	nvtt::Surface surface;
+	surface.setImage(nvtt::InputFormat_BGRA_8UB, width, height, 1, bgra.data());
+
+	return surface;
+}
+
+static void BenchMipmaps()
+{
+	for (int size : {256, 1024, 2048, 4096}) {
+		auto surface = MakeSurface(size, size);
+
+		Bench("BuildMipmapChain/" + std::to_string(size), static_cast<size_t>(size) * size * 4,
+		      [&] { BuildMipmapChain(surface); });
+	}
+}
+
+static void BenchFilters16()
+{
+	for (int size : {1024, 4096}) {
+		auto image = Image16::FromSurface(MakeSurface(size, size));
+		auto bytes = static_cast<size_t>(size) * size * 4;
+
+		Bench("Resize16/" + std::to_string(size) + "->" + std::to_string(size / 2), bytes,
+		      [&] { Resize16(image, size / 2, size / 2); });
+
+		Bench("BuildMipmapChain16/" + std::to_string(size), bytes,
+		      [&] { BuildMipmapChain16(image); });
+	}
+
+	auto surface = MakeSurface(4096, 4096);
+
+	Bench("resize/float/4096->2048", static_cast<size_t>(4096) * 4096 * 4, [&] {
+		auto resized = surface;
+		resized.resize(2048, nvtt::RoundMode_None, nvtt::ResizeFilter_Kaiser);
+	});
+}
+
+static void BenchGuessFormat()
+{
+	const std::vector<std::wstring> suffixes = {
+		L"_B", L"_R", L"_I", L"_N", L"_AO", L"_DirtMask", L"_D", L"_H", L"_M",
+		L"_L", L"_CoatR", L"_X",
+	};
+
+	for (size_t count : {1000, 100000}) {
+		std::vector<std::filesystem::path> names;
+		for (size_t i = 0; i < count; ++i) {
+			names.push_back(L"Skin/Material" + std::to_wstring(i) +
+					suffixes[i % suffixes.size()] + L".png");
+		}
+
+		nvtt::Surface image;
+
+		Bench("GuessFormat/" + std::to_string(count), 0, [&] {
+			size_t guessed = 0;
+			for (auto &name : names)
+				guessed += GuessFormat(name, image).has_value();
+
+			if (guessed == 0)
+				std::abort();
+		});
+	}
+}
+
+static void BenchBufferHandler()
+{
+	const size_t total = 16 << 20;
+
+	for (size_t chunk : {size_t{128}, size_t{4096}, size_t{1 << 20}, total}) {
+		std::vector<uint8_t> data(chunk);
+
+		Bench("BufferHandler::writeData/" + std::to_string(chunk), total, [&] {
+			BufferHandler handler;
+			for (size_t written = 0; written < total; written += chunk)
+				handler.writeData(data.data(), static_cast<int>(chunk));
+		});
+	}
+
+	// DDS header followed by a full 4096px BC3 mip chain, one write per level
+	std::vector<size_t> levels = {128};
+	for (int size = 4096; size >= 1; size /= 2)
+		levels.push_back(static_cast<size_t>(BlocksFor(size)) * BlocksFor(size) * 16);
+
+	size_t chain_bytes = 0;
+	for (auto level : levels)
+		chain_bytes += level;
+
+	std::vector<uint8_t> data(levels[1]);
+
+	Bench("BufferHandler::writeData/mip-chain", chain_bytes, [&] {
+		BufferHandler handler;
+		for (auto level : levels)
+			handler.writeData(data.data(), static_cast<int>(level));
+	});
+}
+
+static void BenchCompress()
+{
+	nvtt::Context ctx;
+	ctx.enableCudaAcceleration(false);
+
+	const std::pair<nvtt::Quality, const char *> qualities[] = {
+		{nvtt::Quality_Fastest, "Fastest"},
+		{nvtt::Quality_Normal, "Normal"},
+		{nvtt::Quality_Highest, "Highest"},
+	};
+
+	auto surface = MakeSurface(512, 512);
+
+	for (auto format : {nvtt::Format_BC1, nvtt::Format_BC3, nvtt::Format_BC5}) {
+		for (auto [quality, quality_name] : qualities) {
+			nvtt::CompressionOptions compression_options;
+			compression_options.setFormat(format);
+			compression_options.setQuality(quality);
+
+			BufferHandler handler;
+			nvtt::OutputOptions output_options;
+			output_options.setOutputHandler(&handler);
+
+			Bench("compress/" + FormatToString(format) + "/" + quality_name,
+			      static_cast<size_t>(surface.width()) * surface.height() * 4, [&] {
+				      handler.buffer.clear();
+				      ctx.compress(surface, 0, 0, compression_options,
+						   output_options);
+			      });
+		}
+	}
+}
+
+// RMSE over the channels a format stores, against the 8-bit source texels
+static double BlocksRmse(const nvtt::Surface &surface, nvtt::Format format,
+			 const std::vector<uint8_t> &blocks)
+{
+	auto width = surface.width();
+	auto height = surface.height();
+	auto block_size = BlockSize(format);
+	auto channels = format == nvtt::Format_BC5 ? 2 : format == nvtt::Format_BC3 ? 4 : 3;
+
+	double sum = 0;
+	size_t count = 0;
+
+	auto blocks_x = BlocksFor(width);
+
+	for (int by = 0; by < BlocksFor(height); ++by) {
+		for (int bx = 0; bx < blocks_x; ++bx) {
+			auto index = static_cast<size_t>(by) * blocks_x + bx;
+			auto block = &blocks[index * block_size];
+
+			uint8_t rgba[64];
+			if (format == nvtt::Format_BC1)
+				DecodeBC1Block(block, rgba);
+			else if (format == nvtt::Format_BC3)
+				DecodeBC3Block(block, rgba);
+			else
+				DecodeBC5Block(block, rgba);
+
+			for (int i = 0; i < 16; ++i) {
+				auto x = bx * 4 + i % 4;
+				auto y = by * 4 + i / 4;
+				if (x >= width || y >= height)
+					continue;
+
+				for (int c = 0; c < channels; ++c) {
+					auto texel = static_cast<size_t>(y) * width + x;
+					auto value = std::clamp(surface.channel(c)[texel], 0.0f, 1.0f);
+					auto source = std::nearbyint(value * 255.0f);
+					auto error = source - rgba[i * 4 + c];
+
+					sum += error * error;
+					++count;
+				}
+			}
+		}
+	}
+
+	return std::sqrt(sum / count);
+}
+
+static void BenchBuiltinEncoder()
+{
+	nvtt::Context ctx;
+	ctx.enableCudaAcceleration(false);
+
+	auto surface = MakeSurface(512, 512);
+
+	for (auto format : {nvtt::Format_BC1, nvtt::Format_BC3, nvtt::Format_BC5}) {
+		auto name = "builtin/" + FormatToString(format);
+		if (!filter.empty() && name.find(filter) == std::string::npos)
+			continue;
+
+		std::vector<uint8_t> blocks;
+		Bench(name, static_cast<size_t>(surface.width()) * surface.height() * 4, [&] {
+			blocks.clear();
+			EncodeBlocks(surface, format, blocks);
+		});
+
+		std::printf("%-48s %9.3f rmse", name.c_str(), BlocksRmse(surface, format, blocks));
+
+		const std::pair<nvtt::Quality, const char *> qualities[] = {
+			{nvtt::Quality_Fastest, "Fastest"},
+			{nvtt::Quality_Normal, "Normal"},
+		};
+
+		for (auto [quality, quality_name] : qualities) {
+			nvtt::CompressionOptions compression_options;
+			compression_options.setFormat(format);
+			compression_options.setQuality(quality);
+
+			BufferHandler handler;
+			nvtt::OutputOptions output_options;
+			output_options.setOutputHandler(&handler);
+
+			ctx.compress(surface, 0, 0, compression_options, output_options);
+
+			std::printf("  nvtt %s %.3f", quality_name,
+				    BlocksRmse(surface, format, handler.buffer));
+		}
+
+		std::printf("\n");
+	}
+}
+
+static void BenchZip()
+{
+	const size_t entries = 16;
+
+	for (size_t entry_size : {size_t{64 << 10}, size_t{8 << 20}}) {
+		std::vector<uint8_t> data(entry_size);
+		std::mt19937 rng{1234};
+		for (auto &byte : data)
+			byte = static_cast<uint8_t>(rng() & 0x3f);
+
+		Bench("wxZipOutputStream/" + std::to_string(entry_size), entries * entry_size, [&] {
+			wxCountingOutputStream output_stream;
+			wxZipOutputStream zip_stream(output_stream);
+			wxDataOutputStream data_stream(zip_stream);
+
+			for (size_t i = 0; i < entries; ++i) {
+				zip_stream.PutNextEntry(std::to_wstring(i) + L".dds");
+				data_stream.Write8(data.data(), data.size());
+			}
+
+			zip_stream.Close();
+		});
+	}
+}
+
+// Mipmaps and built-in BC1 over a batch of images, the CPU-bound part of an
+// export, under each thread count and affinity
+static void BenchEngine()
+{
+	const int images = 64;
+	auto source = MakeSurface(256, 256);
+
+	auto processors = LogicalProcessorCount();
+
+	std::vector<EngineOptions> configurations;
+	for (auto threads : std::set<int>{1, std::max(1, processors / 2), processors}) {
+		for (auto affinity :
+		     {AFFINITY_NONE, AFFINITY_COMPACT, AFFINITY_SCATTER, AFFINITY_NUMA})
+			configurations.push_back({threads, PRIORITY_NORMAL, affinity});
+	}
+
+	configurations.push_back({processors, PRIORITY_BACKGROUND, AFFINITY_NONE});
+
+	for (auto &options : configurations) {
+		Bench("engine/" + DescribeEngine(options),
+		      static_cast<size_t>(images) * source.width() * source.height() * 4, [&] {
+#pragma omp parallel num_threads(WorkerCount(options))
+			      {
+				      ApplyWorkerSettings(options, omp_get_thread_num());
+
+#pragma omp for schedule(dynamic)
+				      for (int i = 0; i < images; ++i) {
+					      std::vector<uint8_t> blocks;
+					      for (auto &level : BuildMipmapChain(source))
+						      EncodeBlocks(level, nvtt::Format_BC1, blocks);
+				      }
+			      }
+		      });
+	}
+
+	// Pool threads keep their settings, put them back for anything run later
+#pragma omp parallel
+	ApplyWorkerSettings(EngineOptions{}, omp_get_thread_num());
+}
+
+int main(int argc, char **argv)
+{
+	wxInitializer initializer;
+	if (!initializer.IsOk())
+		return 1;
+
+	if (argc > 1)
+		filter = argv[1];
+
+	BenchMipmaps();
+	BenchFilters16();
+	BenchGuessFormat();
+	BenchBufferHandler();
+	BenchCompress();
+	BenchBuiltinEncoder();
+	BenchZip();
+	BenchEngine();
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,502 @@
+#include "bc_encoder.hpp"
+#include "texture.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define BC_SSE2
+#include <emmintrin.h>
+#endif
+
+// Planar float copy of one block's colour channels
+struct ColorBlock {
+	alignas(16) float r[16];
+	alignas(16) float g[16];
+	alignas(16) float b[16];
+};
+
+struct Color {
+	float r, g, b;
+};
+
+static uint16_t To565(const Color &color)
+{
+	auto r = static_cast<int>(std::clamp(color.r, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+	auto g = static_cast<int>(std::clamp(color.g, 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+	auto b = static_cast<int>(std::clamp(color.b, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static Color From565(uint16_t color)
+{
+	auto r = (color >> 11) & 0x1f;
+	auto g = (color >> 5) & 0x3f;
+	auto b = color & 0x1f;
+
+	return {float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2))};
+}
+
+static void MakePalette(uint16_t c0, uint16_t c1, Color palette[4])
+{
+	palette[0] = From565(c0);
+	palette[1] = From565(c1);
+
+	auto &p0 = palette[0];
+	auto &p1 = palette[1];
+
+	palette[2] = {(2 * p0.r + p1.r) / 3, (2 * p0.g + p1.g) / 3, (2 * p0.b + p1.b) / 3};
+	palette[3] = {(p0.r + 2 * p1.r) / 3, (p0.g + 2 * p1.g) / 3, (p0.b + 2 * p1.b) / 3};
+}
+
+// Picks the nearest palette entry for every texel, returning packed 2-bit
+// indices and the summed squared error
+static uint32_t MatchIndices(const ColorBlock &block, const Color palette[4], float &error)
+{
+	uint32_t indices = 0;
+	error = 0.0f;
+
+#ifdef BC_SSE2
+	alignas(16) int32_t best[16];
+	auto total = _mm_setzero_ps();
+
+	for (int group = 0; group < 4; ++group) {
+		auto r = _mm_load_ps(&block.r[group * 4]);
+		auto g = _mm_load_ps(&block.g[group * 4]);
+		auto b = _mm_load_ps(&block.b[group * 4]);
+
+		auto best_distance = _mm_set1_ps(1e30f);
+		auto best_index = _mm_setzero_si128();
+
+		for (int p = 0; p < 4; ++p) {
+			auto dr = _mm_sub_ps(r, _mm_set1_ps(palette[p].r));
+			auto dg = _mm_sub_ps(g, _mm_set1_ps(palette[p].g));
+			auto db = _mm_sub_ps(b, _mm_set1_ps(palette[p].b));
+
+			auto distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+						   _mm_mul_ps(db, db));
+
+			auto closer = _mm_castps_si128(_mm_cmplt_ps(distance, best_distance));
+
+			best_distance = _mm_min_ps(distance, best_distance);
+			best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)),
+						  _mm_andnot_si128(closer, best_index));
+		}
+
+		total = _mm_add_ps(total, best_distance);
+		_mm_store_si128(reinterpret_cast<__m128i *>(&best[group * 4]), best_index);
+	}
+
+	alignas(16) float totals[4];
+	_mm_store_ps(totals, total);
+	error = totals[0] + totals[1] + totals[2] + totals[3];
+
+	for (int i = 0; i < 16; ++i)
+		indices |= static_cast<uint32_t>(best[i]) << (2 * i);
+#else
+	for (int i = 0; i < 16; ++i) {
+		auto best_distance = 1e30f;
+		auto best_index = 0;
+
+		for (int p = 0; p < 4; ++p) {
+			auto dr = block.r[i] - palette[p].r;
+			auto dg = block.g[i] - palette[p].g;
+			auto db = block.b[i] - palette[p].b;
+
+			auto distance = dr * dr + dg * dg + db * db;
+			if (distance < best_distance) {
+				best_distance = distance;
+				best_index = p;
+			}
+		}
+
+		error += best_distance;
+		indices |= static_cast<uint32_t>(best_index) << (2 * i);
+	}
+#endif
+
+	return indices;
+}
+
+// Endpoints along the block's principal axis, inset by 1/16 of the range
+static void FitEndpoints(const ColorBlock &block, Color &max, Color &min)
+{
+	Color mean{0.0f, 0.0f, 0.0f};
+	for (int i = 0; i < 16; ++i) {
+		mean.r += block.r[i];
+		mean.g += block.g[i];
+		mean.b += block.b[i];
+	}
+
+	mean = {mean.r / 16, mean.g / 16, mean.b / 16};
+
+	float cov[6] = {};
+	for (int i = 0; i < 16; ++i) {
+		auto r = block.r[i] - mean.r;
+		auto g = block.g[i] - mean.g;
+		auto b = block.b[i] - mean.b;
+
+		cov[0] += r * r;
+		cov[1] += r * g;
+		cov[2] += r * b;
+		cov[3] += g * g;
+		cov[4] += g * b;
+		cov[5] += b * b;
+	}
+
+	Color axis{cov[0] + cov[1] + cov[2], cov[1] + cov[3] + cov[4], cov[2] + cov[4] + cov[5]};
+	for (int iteration = 0; iteration < 4; ++iteration) {
+		Color next{cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+			   cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+			   cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b};
+
+		auto length = std::max({std::fabs(next.r), std::fabs(next.g), std::fabs(next.b)});
+		if (length < 1e-6f)
+			break;
+
+		axis = {next.r / length, next.g / length, next.b / length};
+	}
+
+	auto length = std::sqrt(axis.r * axis.r + axis.g * axis.g + axis.b * axis.b);
+	if (length < 1e-6f)
+		axis = {0.57735f, 0.57735f, 0.57735f};
+	else
+		axis = {axis.r / length, axis.g / length, axis.b / length};
+
+	auto t_min = 1e30f;
+	auto t_max = -1e30f;
+
+	for (int i = 0; i < 16; ++i) {
+		auto t = (block.r[i] - mean.r) * axis.r + (block.g[i] - mean.g) * axis.g +
+			 (block.b[i] - mean.b) * axis.b;
+
+		t_min = std::min(t_min, t);
+		t_max = std::max(t_max, t);
+	}
+
+	auto inset = (t_max - t_min) / 16.0f;
+	t_min += inset;
+	t_max -= inset;
+
+	max = {mean.r + axis.r * t_max, mean.g + axis.g * t_max, mean.b + axis.b * t_max};
+	min = {mean.r + axis.r * t_min, mean.g + axis.g * t_min, mean.b + axis.b * t_min};
+}
+
+// Least-squares endpoints for a fixed set of indices
+static bool RefineEndpoints(const ColorBlock &block, uint32_t indices, Color &c0, Color &c1)
+{
+	static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	Color ax{0.0f, 0.0f, 0.0f};
+	Color bx{0.0f, 0.0f, 0.0f};
+
+	for (int i = 0; i < 16; ++i) {
+		auto a = weights[(indices >> (2 * i)) & 3];
+		auto b = 1.0f - a;
+
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+
+		ax = {ax.r + a * block.r[i], ax.g + a * block.g[i], ax.b + a * block.b[i]};
+		bx = {bx.r + b * block.r[i], bx.g + b * block.g[i], bx.b + b * block.b[i]};
+	}
+
+	auto det = aa * bb - ab * ab;
+	if (std::fabs(det) < 1e-6f)
+		return false;
+
+	auto inv = 1.0f / det;
+
+	c0 = {(ax.r * bb - bx.r * ab) * inv, (ax.g * bb - bx.g * ab) * inv,
+	      (ax.b * bb - bx.b * ab) * inv};
+	c1 = {(bx.r * aa - ax.r * ab) * inv, (bx.g * aa - ax.g * ab) * inv,
+	      (bx.b * aa - ax.b * ab) * inv};
+
+	return true;
+}
+
+static void EncodeColorBlock(const uint8_t *rgba, uint8_t *block)
+{
+	ColorBlock colors;
+	for (int i = 0; i < 16; ++i) {
+		colors.r[i] = rgba[i * 4 + 0];
+		colors.g[i] = rgba[i * 4 + 1];
+		colors.b[i] = rgba[i * 4 + 2];
+	}
+
+	Color max, min;
+	FitEndpoints(colors, max, min);
+
+	auto c0 = To565(max);
+	auto c1 = To565(min);
+
+	Color palette[4];
+	MakePalette(c0, c1, palette);
+
+	float error;
+	auto indices = MatchIndices(colors, palette, error);
+
+	Color refined0, refined1;
+	if (RefineEndpoints(colors, indices, refined0, refined1)) {
+		auto r0 = To565(refined0);
+		auto r1 = To565(refined1);
+
+		MakePalette(r0, r1, palette);
+
+		float refined_error;
+		auto refined_indices = MatchIndices(colors, palette, refined_error);
+
+		if (refined_error < error) {
+			c0 = r0;
+			c1 = r1;
+			indices = refined_indices;
+		}
+	}
+
+	// BC1 is only in four-colour mode when c0 > c1. Swapping the endpoints
+	// swaps indices 0<->1 and 2<->3; equal endpoints can only use index 0.
+	if (c0 < c1) {
+		std::swap(c0, c1);
+		indices ^= 0x55555555;
+	} else if (c0 == c1) {
+		indices = 0;
+	}
+
+	block[0] = c0 & 0xff;
+	block[1] = c0 >> 8;
+	block[2] = c1 & 0xff;
+	block[3] = c1 >> 8;
+
+	for (int i = 0; i < 4; ++i)
+		block[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// BC4-style block of one channel in eight-value mode, channel selects the
+// byte of each RGBA texel
+static void EncodeChannelBlock(const uint8_t *rgba, int channel, uint8_t *block)
+{
+	int min = 255;
+	int max = 0;
+
+	for (int i = 0; i < 16; ++i) {
+		min = std::min<int>(min, rgba[i * 4 + channel]);
+		max = std::max<int>(max, rgba[i * 4 + channel]);
+	}
+
+	block[0] = static_cast<uint8_t>(max);
+	block[1] = static_cast<uint8_t>(min);
+
+	if (max == min) {
+		std::memset(&block[2], 0, 6);
+		return;
+	}
+
+	// Values snap to the nearest of the eight evenly spaced ramp positions.
+	// Position 7 is endpoint 0 (max), 0 is endpoint 1 (min), and position k
+	// in between is index 8 - k.
+	alignas(16) int32_t indices[16];
+	auto scale = 7.0f / (max - min);
+
+#ifdef BC_SSE2
+	for (int group = 0; group < 4; ++group) {
+		auto t = &rgba[group * 16];
+		auto values = _mm_setr_ps(t[channel], t[4 + channel], t[8 + channel], t[12 + channel]);
+
+		auto position = _mm_cvtps_epi32(
+			_mm_mul_ps(_mm_sub_ps(values, _mm_set1_ps(float(min))), _mm_set1_ps(scale)));
+
+		auto index = _mm_and_si128(_mm_sub_epi32(_mm_set1_epi32(8), position),
+					   _mm_set1_epi32(7));
+		auto swap = _mm_and_si128(_mm_cmplt_epi32(index, _mm_set1_epi32(2)),
+					  _mm_set1_epi32(1));
+
+		_mm_store_si128(reinterpret_cast<__m128i *>(&indices[group * 4]),
+				_mm_xor_si128(index, swap));
+	}
+#else
+	for (int i = 0; i < 16; ++i) {
+		auto position = static_cast<int>(
+			std::nearbyint((rgba[i * 4 + channel] - min) * scale));
+		auto index = (8 - position) & 7;
+
+		indices[i] = index < 2 ? index ^ 1 : index;
+	}
+#endif
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 16; ++i)
+		bits |= static_cast<uint64_t>(indices[i]) << (3 * i);
+
+	for (int i = 0; i < 6; ++i)
+		block[2 + i] = (bits >> (8 * i)) & 0xff;
+}
+
+void EncodeBC1Block(const uint8_t *rgba, uint8_t *block)
+{
+	EncodeColorBlock(rgba, block);
+}
+
+void EncodeBC3Block(const uint8_t *rgba, uint8_t *block)
+{
+	EncodeChannelBlock(rgba, 3, block);
+	EncodeColorBlock(rgba, &block[8]);
+}
+
+void EncodeBC5Block(const uint8_t *rgba, uint8_t *block)
+{
+	EncodeChannelBlock(rgba, 0, block);
+	EncodeChannelBlock(rgba, 1, &block[8]);
+}
+
+static void DecodeColorBlock(const uint8_t *block, uint8_t *rgba, bool four_color_only)
+{
+	auto c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+	auto c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+
+	Color palette[4];
+	MakePalette(c0, c1, palette);
+
+	if (!four_color_only && c0 <= c1) {
+		auto &p0 = palette[0];
+		auto &p1 = palette[1];
+
+		palette[2] = {(p0.r + p1.r) / 2, (p0.g + p1.g) / 2, (p0.b + p1.b) / 2};
+		palette[3] = {0.0f, 0.0f, 0.0f};
+	}
+
+	uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) |
+			   (static_cast<uint32_t>(block[7]) << 24);
+
+	for (int i = 0; i < 16; ++i) {
+		auto &color = palette[(indices >> (2 * i)) & 3];
+
+		rgba[i * 4 + 0] = static_cast<uint8_t>(color.r + 0.5f);
+		rgba[i * 4 + 1] = static_cast<uint8_t>(color.g + 0.5f);
+		rgba[i * 4 + 2] = static_cast<uint8_t>(color.b + 0.5f);
+		rgba[i * 4 + 3] = 255;
+	}
+}
+
+static void DecodeChannelBlock(const uint8_t *block, uint8_t *rgba, int channel)
+{
+	int a0 = block[0];
+	int a1 = block[1];
+
+	int values[8] = {a0, a1};
+	if (a0 > a1) {
+		for (int i = 2; i < 8; ++i)
+			values[i] = ((8 - i) * a0 + (i - 1) * a1 + 3) / 7;
+	} else {
+		for (int i = 2; i < 6; ++i)
+			values[i] = ((6 - i) * a0 + (i - 1) * a1 + 2) / 5;
+
+		values[6] = 0;
+		values[7] = 255;
+	}
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; ++i)
+		bits |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+
+	for (int i = 0; i < 16; ++i)
+		rgba[i * 4 + channel] = static_cast<uint8_t>(values[(bits >> (3 * i)) & 7]);
+}
+
+void DecodeBC1Block(const uint8_t *block, uint8_t *rgba)
+{
+	DecodeColorBlock(block, rgba, false);
+}
+
+void DecodeBC3Block(const uint8_t *block, uint8_t *rgba)
+{
+	DecodeColorBlock(&block[8], rgba, true);
+	DecodeChannelBlock(block, rgba, 3);
+}
+
+void DecodeBC5Block(const uint8_t *block, uint8_t *rgba)
+{
+	for (int i = 0; i < 16; ++i) {
+		rgba[i * 4 + 2] = 0;
+		rgba[i * 4 + 3] = 255;
+	}
+
+	DecodeChannelBlock(block, rgba, 0);
+	DecodeChannelBlock(&block[8], rgba, 1);
+}
+
+bool IsBuiltinFormat(nvtt::Format format)
+{
+	return format == nvtt::Format_BC1 || format == nvtt::Format_BC3 ||
+	       format == nvtt::Format_BC5;
+}
+
+bool EncodeBlocks(const nvtt::Surface &surface, nvtt::Format format,
+		  std::vector<uint8_t> &blocks)
+{
+	void (*encode)(const uint8_t *, uint8_t *);
+
+	switch (format) {
+	case nvtt::Format_BC1:
+		encode = EncodeBC1Block;
+		break;
+	case nvtt::Format_BC3:
+		encode = EncodeBC3Block;
+		break;
+	case nvtt::Format_BC5:
+		encode = EncodeBC5Block;
+		break;
+	default:
+		return false;
+	}
+
+	auto width = surface.width();
+	auto height = surface.height();
+	auto block_size = BlockSize(format);
+
+	auto blocks_x = BlocksFor(width);
+	auto blocks_y = BlocksFor(height);
+
+	auto offset = blocks.size();
+	blocks.resize(offset + static_cast<size_t>(blocks_x) * blocks_y * block_size);
+
+	// One band of four rows converted to RGBA8 at a time
+	std::vector<uint8_t> band(static_cast<size_t>(width) * 4 * 4);
+	alignas(16) uint8_t rgba[64];
+
+	for (int by = 0; by < blocks_y; ++by) {
+		for (int c = 0; c < 4; ++c) {
+			auto channel = surface.channel(c);
+
+			for (int y = 0; y < 4; ++y) {
+				auto row = std::min(by * 4 + y, height - 1);
+				auto src = &channel[static_cast<size_t>(row) * width];
+				auto dst = &band[static_cast<size_t>(y) * width * 4];
+
+				for (int x = 0; x < width; ++x) {
+					auto f = std::clamp(src[x], 0.0f, 1.0f);
+					dst[x * 4 + c] = static_cast<uint8_t>(f * 255.0f + 0.5f);
+				}
+			}
+		}
+
+		for (int bx = 0; bx < blocks_x; ++bx) {
+			for (int y = 0; y < 4; ++y) {
+				for (int x = 0; x < 4; ++x) {
+					auto column = std::min(bx * 4 + x, width - 1);
+					std::memcpy(&rgba[(y * 4 + x) * 4],
+						    &band[(static_cast<size_t>(y) * width + column) * 4],
+						    4);
+				}
+			}
+
+			encode(rgba, &blocks[offset]);
+			offset += block_size;
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <nvtt/nvtt.h>
+
+#include <cstdint>
+#include <vector>
+
+// In-tree block encoder for the formats GuessFormat produces. Takes a 4x4
+// block of interleaved RGBA8 texels.
+void EncodeBC1Block(const uint8_t *rgba, uint8_t *block);
+void EncodeBC3Block(const uint8_t *rgba, uint8_t *block);
+void EncodeBC5Block(const uint8_t *rgba, uint8_t *block);
+
+// Decoders, used to measure encoder error
+void DecodeBC1Block(const uint8_t *block, uint8_t *rgba);
+void DecodeBC3Block(const uint8_t *block, uint8_t *rgba);
+void DecodeBC5Block(const uint8_t *block, uint8_t *rgba);
+
+bool IsBuiltinFormat(nvtt::Format format);
+
+// Appends the blocks of surface in row-major order, the same layout ctx.compress
+// writes for a single mip level. Edge blocks repeat the last row and column.
+bool EncodeBlocks(const nvtt::Surface &surface, nvtt::Format format,
+		  std::vector<uint8_t> &blocks);
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "checkpoint.hpp"
+
+static std::string ToUtf8(const std::filesystem::path &path)
+{
+	auto utf8 = path.generic_u8string();
+	return {utf8.begin(), utf8.end()};
+}
+
+static std::filesystem::path FromUtf8(const std::string &text)
+{
+	return std::u8string{text.begin(), text.end()};
+}
+
+Checkpoint::Checkpoint(std::filesystem::path dir) : dir{std::move(dir)}
+{
+	auto journal_path = this->dir / "journal.txt";
+
+	std::ifstream file(journal_path);
+	for (std::string line; std::getline(file, line);) {
+		auto space = line.find(' ');
+		if (space == std::string::npos)
+			continue;
+
+		entries[FromUtf8(line.substr(space + 1))] = line.substr(0, space);
+	}
+}
+
+bool Checkpoint::Has(const std::filesystem::path &output, const std::string &key) const
+{
+	auto it = entries.find(output);
+	return it != entries.end() && it->second == key;
+}
+
+void Checkpoint::Record(const std::filesystem::path &output, const std::string &key)
+{
+	std::lock_guard lock{mutex};
+
+	if (!journal.is_open()) {
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+
+		journal.open(dir / "journal.txt", std::ios::app);
+	}
+
+	journal << key << ' ' << ToUtf8(output) << '\n';
+	journal.flush();
+}
+
+void Checkpoint::Remove()
+{
+	std::lock_guard lock{mutex};
+
+	journal.close();
+
+	std::error_code ec;
+	std::filesystem::remove_all(dir, ec);
+}
\ No newline at end of file
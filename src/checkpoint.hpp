@@ -0,0 +1,40 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Journal of the outputs of a job that are already written, so an export that
+// was cancelled or killed can be run again and only compress what is missing.
+// Each line is appended and flushed after its output is complete, a line cut
+// short by a crash just fails to match. Outputs of archive jobs are kept as
+// files in the checkpoint directory until the archive is written.
+class Checkpoint {
+public:
+	explicit Checkpoint(std::filesystem::path dir);
+
+	// True if output was recorded with the same content and settings key
+	bool Has(const std::filesystem::path &output, const std::string &key) const;
+	void Record(const std::filesystem::path &output, const std::string &key);
+
+	std::filesystem::path PathFor(const std::filesystem::path &output) const
+	{
+		return dir / output;
+	}
+
+	size_t Size() const { return entries.size(); }
+
+	// Deletes the journal and any checkpointed outputs once the job is done
+	void Remove();
+
+private:
+	std::filesystem::path dir;
+
+	// Loaded once when the export starts and only read after that
+	std::map<std::filesystem::path, std::string> entries;
+
+	std::mutex mutex;
+	std::ofstream journal;
+};
\ No newline at end of file
@@ -12,7 +12,18 @@ enum ID {
 	ID_MAX_RES_CHOICE,
 	ID_QUALITY_CHOICE,
 	ID_BUILD_MIPMAPS_CHOICE,
+	ID_WORKING_FORMAT_CHOICE,
+	ID_CACHE_PICKER,
+	ID_CACHE_SIZE_CHOICE,
+	ID_THREADS_CHOICE,
+	ID_PRIORITY_CHOICE,
+	ID_AFFINITY_CHOICE,
+	ID_QUEUE_BUTTON,
+	ID_CLEAR_QUEUE_BUTTON,
+	ID_PLAN_BUTTON,
 	ID_EXPORT_BUTTON,
+	ID_CANCEL_BUTTON,
+	ID_PROGRESS_TIMER,
 };
 
 enum FORMAT {
@@ -26,11 +37,34 @@ enum MODE {
 	MODE_MOD,
 };
 
+enum QUALITY {
+	QUALITY_FASTEST = 0,
+	QUALITY_NORMAL,
+	QUALITY_HIGHEST,
+	QUALITY_BUILTIN,
+};
+
+enum WORKING_FORMAT {
+	WORKING_FORMAT_FLOAT = 0,
+	WORKING_FORMAT_UNORM16,
+	WORKING_FORMAT_COMPARE,
+};
+
+enum PRIORITY {
+	PRIORITY_NORMAL = 0,
+	PRIORITY_LOW,
+	PRIORITY_BACKGROUND,
+};
+
+enum AFFINITY {
+	AFFINITY_NONE = 0,
+	AFFINITY_COMPACT,
+	AFFINITY_SCATTER,
+	AFFINITY_NUMA,
+};
+
 static const std::set<std::string> input_extensions = {
 	".png", ".PNG", ".jpg", ".JPG", ".jpeg", ".jpeg",
 };
 
-wxDECLARE_EVENT(EVT_EXPORT_FINISHED, wxThreadEvent);
-wxDECLARE_EVENT(EVT_EXPORT_PROGRESS, wxThreadEvent);
-wxDECLARE_EVENT(EVT_EXPORT_PROGRESS_RANGE, wxThreadEvent);
-wxDECLARE_EVENT(EVT_EXPORT_PROGRESS_RESET, wxThreadEvent);
\ No newline at end of file
+wxDECLARE_EVENT(EVT_EXPORT_FINISHED, wxThreadEvent);
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "compression_cache.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+
+// Stop evicting once the cache is back under this fraction of its limit, so
+// a full cache does not rescan on every write
+static constexpr double evict_target = 0.9;
+
+// Temporary files older than this belong to a writer that died mid-write
+static constexpr auto stale_temp_age = std::chrono::hours(1);
+
+DirectoryCacheStore::DirectoryCacheStore(std::filesystem::path root, uint64_t max_bytes)
+	: root{std::move(root)}, max_bytes{max_bytes}
+{
+	std::error_code ec;
+	std::filesystem::create_directories(this->root, ec);
+
+	estimated_bytes = Scan();
+}
+
+std::filesystem::path DirectoryCacheStore::PathFor(const std::string &key) const
+{
+	return root / key.substr(0, 2) / (key + ".dds");
+}
+
+uint64_t DirectoryCacheStore::Scan()
+{
+	uint64_t total = 0;
+
+	std::error_code ec;
+	for (auto it = std::filesystem::recursive_directory_iterator(root, ec);
+	     !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+		if (it->is_regular_file(ec) && it->path().extension() == ".dds")
+			total += it->file_size(ec);
+	}
+
+	return total;
+}
+
+void DirectoryCacheStore::Evict()
+{
+	std::lock_guard lock{evict_mutex};
+
+	struct Entry {
+		std::filesystem::path path;
+		std::filesystem::file_time_type last_use;
+		uint64_t size;
+	};
+
+	std::vector<Entry> entries;
+	uint64_t total = 0;
+
+	auto now = std::filesystem::file_time_type::clock::now();
+
+	std::error_code ec;
+	for (auto it = std::filesystem::recursive_directory_iterator(root, ec);
+	     !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+		if (!it->is_regular_file(ec))
+			continue;
+
+		auto extension = it->path().extension();
+		auto last_use = it->last_write_time(ec);
+
+		if (extension == ".tmp" && now - last_use > stale_temp_age) {
+			std::filesystem::remove(it->path(), ec);
+		} else if (extension == ".dds") {
+			auto size = it->file_size(ec);
+
+			entries.push_back({it->path(), last_use, size});
+			total += size;
+		}
+	}
+
+	if (total > max_bytes) {
+		std::sort(entries.begin(), entries.end(),
+			  [](auto &a, auto &b) { return a.last_use < b.last_use; });
+
+		for (auto &entry : entries) {
+			if (total <= max_bytes * evict_target)
+				break;
+
+			if (std::filesystem::remove(entry.path, ec))
+				total -= entry.size;
+		}
+	}
+
+	estimated_bytes = total;
+}
+
+std::optional<std::vector<uint8_t>> DirectoryCacheStore::Get(const std::string &key)
+{
+	auto path = PathFor(key);
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return std::nullopt;
+
+	std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char *>(data.data()), data.size()))
+		return std::nullopt;
+
+	if (data.size() < 4 || std::string(data.begin(), data.begin() + 4) != "DDS ")
+		return std::nullopt;
+
+	std::error_code ec;
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+	return data;
+}
+
+void DirectoryCacheStore::Put(const std::string &key, const std::vector<uint8_t> &data)
+{
+	auto path = PathFor(key);
+
+	std::error_code ec;
+	if (std::filesystem::exists(path, ec))
+		return;
+
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	// Unique across threads and, with the random part, across machines
+	// sharing the directory
+	static const auto instance = std::random_device{}();
+	auto temp_path = path;
+	temp_path += "." + std::to_string(instance) + "." + std::to_string(temp_counter++) + ".tmp";
+
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(data.data()), data.size());
+
+		if (!file) {
+			file.close();
+			std::filesystem::remove(temp_path, ec);
+
+			return;
+		}
+	}
+
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec) {
+		std::filesystem::remove(temp_path, ec);
+		return;
+	}
+
+	if ((estimated_bytes += data.size()) > max_bytes)
+		Evict();
+}
+
+std::optional<std::string> ComputeCacheKey(const std::filesystem::path &input,
+					   const std::string &settings)
+{
+	Sha256 hash;
+	if (!hash.UpdateFile(input))
+		return std::nullopt;
+
+	hash.Update("\n" + settings);
+
+	return hash.HexDigest();
+}
\ No newline at end of file
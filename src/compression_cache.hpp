@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Storage for compressed DDS outputs keyed by a content hash. Implementations
+// must be safe to call from several worker threads at once.
+class CacheStore {
+public:
+	virtual ~CacheStore() = default;
+
+	virtual std::optional<std::vector<uint8_t>> Get(const std::string &key) = 0;
+	virtual void Put(const std::string &key, const std::vector<uint8_t> &data) = 0;
+};
+
+// Cache in a local or shared directory. Entries are written to a temporary
+// file and renamed into place, so readers on other machines never see a
+// partial entry. Reads refresh an entry's modification time, which is what
+// the size-bounded LRU eviction orders by.
+class DirectoryCacheStore : public CacheStore {
+public:
+	DirectoryCacheStore(std::filesystem::path root, uint64_t max_bytes);
+
+	std::optional<std::vector<uint8_t>> Get(const std::string &key) override;
+	void Put(const std::string &key, const std::vector<uint8_t> &data) override;
+
+private:
+	std::filesystem::path root;
+	uint64_t max_bytes;
+
+	std::mutex evict_mutex;
+	std::atomic<uint64_t> estimated_bytes = 0;
+	std::atomic<uint64_t> temp_counter = 0;
+
+	std::filesystem::path PathFor(const std::string &key) const;
+	uint64_t Scan();
+	void Evict();
+};
+
+// Hashes the input file together with everything else that affects the output
+std::optional<std::string> ComputeCacheKey(const std::filesystem::path &input,
+					   const std::string &settings);
\ No newline at end of file
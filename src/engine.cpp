@@ -0,0 +1,273 @@
+#include "engine.hpp"
+
+#include <omp.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <algorithm>
+#include <format>
+#include <map>
+#include <optional>
+#include <vector>
+
+// Topology, priority and affinity use the Windows APIs; elsewhere, as for
+// the benchmark, workers are left to the OpenMP runtime
+#ifdef _WIN32
+struct Processor {
+	WORD group;
+	BYTE number;
+
+	int core;
+	int smt;
+
+	int node;
+	int node_core;
+
+	// Higher is faster, performance cores on hybrid CPUs have a higher class
+	int efficiency;
+};
+
+struct Topology {
+	std::vector<Processor> processors;
+	int nodes = 1;
+
+	// Fills each core's hardware threads before moving to the next core
+	std::vector<Processor> compact;
+
+	// One thread per physical core first, alternating between nodes
+	std::vector<Processor> scatter;
+
+	// Compact order, split by node
+	std::vector<std::vector<Processor>> by_node;
+};
+
+static Topology QueryTopology()
+{
+	Topology topology;
+	auto &processors = topology.processors;
+
+	DWORD length = 0;
+	GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+
+	std::vector<uint8_t> buffer(length);
+	auto info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.data());
+	if (length == 0 || !GetLogicalProcessorInformationEx(RelationAll, info, &length))
+		return topology;
+
+	std::vector<GROUP_AFFINITY> nodes;
+	int core = 0;
+
+	for (DWORD offset = 0; offset < length;) {
+		auto entry =
+			reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(&buffer[offset]);
+
+		if (entry->Relationship == RelationProcessorCore) {
+			int smt = 0;
+
+			for (WORD i = 0; i < entry->Processor.GroupCount; ++i) {
+				auto &mask = entry->Processor.GroupMask[i];
+
+				for (BYTE bit = 0; bit < sizeof(KAFFINITY) * 8; ++bit) {
+					if (!(mask.Mask & (KAFFINITY{1} << bit)))
+						continue;
+
+					processors.push_back({mask.Group, bit, core, smt++, 0, 0,
+							      entry->Processor.EfficiencyClass});
+				}
+			}
+
+			++core;
+		} else if (entry->Relationship == RelationNumaNode) {
+			nodes.push_back(entry->NumaNode.GroupMask);
+		}
+
+		offset += entry->Size;
+	}
+
+	// Node numbers can be sparse, so nodes are numbered in enumeration order
+	topology.nodes = std::max<int>(1, nodes.size());
+	topology.by_node.resize(topology.nodes);
+
+	std::map<int, int> core_rank;
+	std::vector<int> node_cores(topology.nodes);
+
+	for (auto &processor : processors) {
+		for (int node = 0; node < nodes.size(); ++node) {
+			if (nodes[node].Group == processor.group &&
+			    (nodes[node].Mask >> processor.number) & 1)
+				processor.node = node;
+		}
+
+		if (!core_rank.contains(processor.core))
+			core_rank[processor.core] = node_cores[processor.node]++;
+
+		processor.node_core = core_rank[processor.core];
+	}
+
+	topology.compact = processors;
+	std::stable_sort(topology.compact.begin(), topology.compact.end(), [](auto &a, auto &b) {
+		if (a.efficiency != b.efficiency)
+			return a.efficiency > b.efficiency;
+
+		return a.core != b.core ? a.core < b.core : a.smt < b.smt;
+	});
+
+	topology.scatter = processors;
+	std::stable_sort(topology.scatter.begin(), topology.scatter.end(), [](auto &a, auto &b) {
+		if (a.smt != b.smt)
+			return a.smt < b.smt;
+
+		if (a.efficiency != b.efficiency)
+			return a.efficiency > b.efficiency;
+
+		return a.node_core != b.node_core ? a.node_core < b.node_core : a.node < b.node;
+	});
+
+	for (auto &processor : topology.compact)
+		topology.by_node[processor.node].push_back(processor);
+
+	return topology;
+}
+
+static const Topology &GetTopology()
+{
+	static const Topology topology = QueryTopology();
+	return topology;
+}
+#endif
+
+int LogicalProcessorCount()
+{
+#ifdef _WIN32
+	auto &topology = GetTopology();
+	if (!topology.processors.empty())
+		return static_cast<int>(topology.processors.size());
+#endif
+
+	return omp_get_num_procs();
+}
+
+int NumaNodeCount()
+{
+#ifdef _WIN32
+	return GetTopology().nodes;
+#else
+	return 1;
+#endif
+}
+
+int WorkerCount(const EngineOptions &options)
+{
+	if (options.threads > 0)
+		return options.threads;
+
+	// MSVC's OpenMP only sizes itself to the process's processor group,
+	// pinned workers can use every group
+	return options.affinity == AFFINITY_NONE ? omp_get_num_procs() : LogicalProcessorCount();
+}
+
+#ifdef _WIN32
+static void ApplyPriority(PRIORITY priority)
+{
+	thread_local bool background = false;
+
+	auto thread = GetCurrentThread();
+
+	// Background mode also lowers the thread's I/O and memory priority, so
+	// an export does not push the game's working set out
+	if ((priority == PRIORITY_BACKGROUND) != background) {
+		if (SetThreadPriority(thread, background ? THREAD_MODE_BACKGROUND_END
+							 : THREAD_MODE_BACKGROUND_BEGIN))
+			background = !background;
+	}
+
+	if (!background) {
+		SetThreadPriority(thread, priority == PRIORITY_LOW ? THREAD_PRIORITY_BELOW_NORMAL
+								  : THREAD_PRIORITY_NORMAL);
+	}
+}
+
+static void ApplyAffinity(AFFINITY affinity, int worker)
+{
+	thread_local std::optional<GROUP_AFFINITY> original;
+
+	auto thread = GetCurrentThread();
+	auto &topology = GetTopology();
+
+	if (affinity == AFFINITY_NONE || topology.processors.empty()) {
+		if (original.has_value()) {
+			SetThreadGroupAffinity(thread, &original.value(), nullptr);
+			original.reset();
+		}
+
+		return;
+	}
+
+	GROUP_AFFINITY mask{};
+	Processor ideal;
+
+	if (affinity == AFFINITY_NUMA) {
+		auto &node = topology.by_node[worker % topology.nodes];
+		if (node.empty())
+			return;
+
+		// A node can span processor groups, a thread can only be bound to
+		// one of them
+		ideal = node[worker / topology.nodes % node.size()];
+
+		mask.Group = ideal.group;
+		for (auto &processor : node) {
+			if (processor.group == ideal.group)
+				mask.Mask |= KAFFINITY{1} << processor.number;
+		}
+	} else {
+		auto &order = affinity == AFFINITY_COMPACT ? topology.compact : topology.scatter;
+		ideal = order[worker % order.size()];
+
+		mask.Group = ideal.group;
+		mask.Mask = KAFFINITY{1} << ideal.number;
+	}
+
+	GROUP_AFFINITY previous{};
+	if (!SetThreadGroupAffinity(thread, &mask, &previous))
+		return;
+
+	if (!original.has_value())
+		original = previous;
+
+	// Windows allocates pages from the node of the thread's ideal processor
+	PROCESSOR_NUMBER number{ideal.group, ideal.number, 0};
+	SetThreadIdealProcessorEx(thread, &number, nullptr);
+}
+
+#endif
+
+void ApplyWorkerSettings(const EngineOptions &options, int worker)
+{
+#ifdef _WIN32
+	ApplyPriority(options.priority);
+	ApplyAffinity(options.affinity, worker);
+#endif
+}
+
+std::string DescribeEngine(const EngineOptions &options)
+{
+	std::string priority = "normal";
+	if (options.priority == PRIORITY_LOW)
+		priority = "low";
+	else if (options.priority == PRIORITY_BACKGROUND)
+		priority = "background";
+
+	std::string affinity = "no";
+	if (options.affinity == AFFINITY_COMPACT)
+		affinity = "compact";
+	else if (options.affinity == AFFINITY_SCATTER)
+		affinity = "scatter";
+	else if (options.affinity == AFFINITY_NUMA)
+		affinity = std::format("NUMA ({} nodes)", NumaNodeCount());
+
+	return std::format("{} threads, {} priority, {} affinity", WorkerCount(options), priority,
+			   affinity);
+}
\ No newline at end of file
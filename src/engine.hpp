@@ -0,0 +1,27 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <string>
+
+// How the export worker pool is sized and scheduled
+struct EngineOptions {
+	// 0 uses one worker per logical processor
+	int threads = 0;
+
+	PRIORITY priority = PRIORITY_NORMAL;
+	AFFINITY affinity = AFFINITY_NONE;
+};
+
+int LogicalProcessorCount();
+int NumaNodeCount();
+
+int WorkerCount(const EngineOptions &options);
+
+// Called by each worker at the start of the parallel region, before it
+// allocates anything, so with NUMA affinity its surfaces and buffers are
+// first touched on the node it runs on. Pool threads are reused between
+// exports, so this also undoes the settings of a previous export.
+void ApplyWorkerSettings(const EngineOptions &options, int worker);
+
+std::string DescribeEngine(const EngineOptions &options);
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "engine_panel.hpp"
+
+#include <format>
+
+EnginePanel::EnginePanel(wxWindow *parent, wxWindowID id) : wxPanel(parent, id)
+{
+	auto box = new wxStaticBoxSizer(wxVERTICAL, this, "Engine");
+	auto sizer = new wxFlexGridSizer(2, 3, 0, 0);
+
+	// Threads choice
+	auto threads_choice_label = new wxStaticText(box->GetStaticBox(), wxID_ANY, "Threads");
+	threads_choice = new wxChoice(box->GetStaticBox(), ID_THREADS_CHOICE);
+
+	auto processors = LogicalProcessorCount();
+
+	threads_choice->Append("Auto", reinterpret_cast<void *>(0));
+	for (long long i = 1; i < processors; i *= 2)
+		threads_choice->Append(std::format("{}", i), reinterpret_cast<void *>(i));
+
+	threads_choice->Append(std::format("{}", processors),
+			       reinterpret_cast<void *>(static_cast<long long>(processors)));
+
+	threads_choice->SetSelection(0);
+
+	// Priority choice
+	auto priority_choice_label = new wxStaticText(box->GetStaticBox(), wxID_ANY, "Priority");
+	priority_choice = new wxChoice(box->GetStaticBox(), ID_PRIORITY_CHOICE);
+
+	priority_choice->Append("Normal", reinterpret_cast<void *>(PRIORITY_NORMAL));
+	priority_choice->Append("Low", reinterpret_cast<void *>(PRIORITY_LOW));
+	priority_choice->Append("Background", reinterpret_cast<void *>(PRIORITY_BACKGROUND));
+
+	priority_choice->SetSelection(0);
+
+	// Affinity choice
+	auto affinity_choice_label = new wxStaticText(box->GetStaticBox(), wxID_ANY, "Affinity");
+	affinity_choice = new wxChoice(box->GetStaticBox(), ID_AFFINITY_CHOICE);
+
+	affinity_choice->Append("None", reinterpret_cast<void *>(AFFINITY_NONE));
+	affinity_choice->Append("Compact", reinterpret_cast<void *>(AFFINITY_COMPACT));
+	affinity_choice->Append("Scatter", reinterpret_cast<void *>(AFFINITY_SCATTER));
+	affinity_choice->Append(std::format("NUMA nodes ({})", NumaNodeCount()),
+				reinterpret_cast<void *>(AFFINITY_NUMA));
+
+	affinity_choice->SetSelection(0);
+
+	// Sizing
+	sizer->Add(threads_choice_label, wxSizerFlags().Border(wxRIGHT | wxTOP | wxBOTTOM));
+	sizer->Add(priority_choice_label, wxSizerFlags().Border(wxALL));
+	sizer->Add(affinity_choice_label, wxSizerFlags().Border(wxLEFT | wxTOP | wxBOTTOM));
+
+	sizer->Add(threads_choice, wxSizerFlags().Expand().Border(wxRIGHT | wxBOTTOM));
+	sizer->Add(priority_choice, wxSizerFlags().Expand().Border(wxLEFT | wxRIGHT | wxBOTTOM));
+	sizer->Add(affinity_choice, wxSizerFlags().Expand().Border(wxLEFT | wxBOTTOM));
+
+	sizer->AddGrowableCol(0);
+	sizer->AddGrowableCol(1);
+	sizer->AddGrowableCol(2);
+
+	box->Add(sizer, wxSizerFlags().Expand().Border());
+
+	SetSizerAndFit(box);
+}
+
+void EnginePanel::SetOptions(const EngineOptions &options)
+{
+	auto threads_label = std::format("{}", options.threads);
+
+	// Saved on a machine with a different processor count
+	auto threads = options.threads > 0 ? threads_choice->FindString(threads_label) : 0;
+	if (threads == wxNOT_FOUND) {
+		threads = threads_choice->Append(
+			threads_label, reinterpret_cast<void *>(static_cast<long long>(options.threads)));
+	}
+
+	threads_choice->SetSelection(threads);
+
+	priority_choice->SetSelection(options.priority);
+	affinity_choice->SetSelection(options.affinity);
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "common.hpp"
+#include "engine.hpp"
+
+#include <wx/wx.h>
+
+class EnginePanel : public wxPanel {
+public:
+	EnginePanel(wxWindow *parent, wxWindowID id = wxID_ANY);
+
+	void SetOptions(const EngineOptions &options);
+
+private:
+	wxChoice *threads_choice;
+	wxChoice *priority_choice;
+	wxChoice *affinity_choice;
+};
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "export_channel.hpp"
+
+#include <omp.h>
+
+#include <algorithm>
+
+bool LogRing::Push(LogRecord record)
+{
+	auto head = this->head.load(std::memory_order_relaxed);
+	if (head - tail.load(std::memory_order_acquire) == records.size())
+		return false;
+
+	records[head % records.size()] = std::move(record);
+	this->head.store(head + 1, std::memory_order_release);
+
+	return true;
+}
+
+void LogRing::Drain(std::vector<LogRecord> &out)
+{
+	auto tail = this->tail.load(std::memory_order_relaxed);
+	auto head = this->head.load(std::memory_order_acquire);
+
+	for (; tail != head; ++tail)
+		out.push_back(std::move(records[tail % records.size()]));
+
+	this->tail.store(tail, std::memory_order_release);
+}
+
+ExportChannel::ExportChannel(int workers) : workers(std::max(1, workers)) {}
+
+ExportChannel::Worker &ExportChannel::Current()
+{
+	// Outside the parallel region this is 0, the export thread itself, which
+	// is also the master thread inside it
+	return workers[omp_get_thread_num() % workers.size()];
+}
+
+void ExportChannel::Log(wxLogLevel level, const wxString &text)
+{
+	auto &worker = Current();
+
+	LogRecord record{sequence.fetch_add(1, std::memory_order_relaxed), level, time(nullptr),
+			 text};
+
+	if (!worker.log.Push(std::move(record)))
+		worker.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ExportChannel::Progress(uint64_t items, uint64_t bytes)
+{
+	auto &worker = Current();
+
+	worker.items.fetch_add(items, std::memory_order_relaxed);
+	worker.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void ExportChannel::SetTotals(uint64_t items, uint64_t bytes)
+{
+	items_total = items;
+	bytes_total = bytes;
+}
+
+std::vector<LogRecord> ExportChannel::Drain()
+{
+	std::vector<LogRecord> records;
+	uint64_t dropped = 0;
+
+	for (auto &worker : workers) {
+		worker.log.Drain(records);
+		dropped += worker.dropped.exchange(0, std::memory_order_relaxed);
+	}
+
+	std::sort(records.begin(), records.end(),
+		  [](auto &a, auto &b) { return a.sequence < b.sequence; });
+
+	if (dropped > 0) {
+		records.push_back({sequence++, wxLOG_Warning, time(nullptr),
+				   wxString::Format("%llu log messages dropped", dropped)});
+	}
+
+	return records;
+}
+
+ExportProgress ExportChannel::Snapshot() const
+{
+	ExportProgress progress{0, items_total, 0, bytes_total};
+
+	for (auto &worker : workers) {
+		progress.items += worker.items.load(std::memory_order_relaxed);
+		progress.bytes += worker.bytes.load(std::memory_order_relaxed);
+	}
+
+	return progress;
+}
\ No newline at end of file
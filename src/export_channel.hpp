@@ -0,0 +1,93 @@
+#pragma once
+
+#include <wx/wx.h>
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+struct LogRecord {
+	uint64_t sequence;
+	wxLogLevel level;
+	time_t time;
+	wxString text;
+};
+
+// Single-producer single-consumer ring of log records
+class LogRing {
+public:
+	explicit LogRing(size_t capacity) : records(capacity) {}
+
+	bool Push(LogRecord record);
+	void Drain(std::vector<LogRecord> &out);
+
+private:
+	std::vector<LogRecord> records;
+
+	alignas(64) std::atomic<size_t> head = 0;
+	alignas(64) std::atomic<size_t> tail = 0;
+};
+
+struct ExportProgress {
+	uint64_t items;
+	uint64_t items_total;
+	uint64_t bytes;
+	uint64_t bytes_total;
+};
+
+// Log and progress channel from the export workers to the UI, and the cancel
+// flag back. Workers write only to their own slot, found by their OpenMP
+// thread number, and never wait on the UI or on each other; the UI drains
+// every slot on a timer.
+class ExportChannel {
+public:
+	explicit ExportChannel(int workers);
+
+	void Log(wxLogLevel level, const wxString &text);
+
+	template <typename... Args> void Message(const wxString &format, const Args &...args)
+	{
+		Log(wxLOG_Message, wxString::Format(format, args...));
+	}
+
+	template <typename... Args> void Warning(const wxString &format, const Args &...args)
+	{
+		Log(wxLOG_Warning, wxString::Format(format, args...));
+	}
+
+	template <typename... Args> void Error(const wxString &format, const Args &...args)
+	{
+		Log(wxLOG_Error, wxString::Format(format, args...));
+	}
+
+	void Progress(uint64_t items, uint64_t bytes);
+	void SetTotals(uint64_t items, uint64_t bytes);
+
+	void Cancel() { cancelled = true; }
+	bool Cancelled() const { return cancelled.load(std::memory_order_relaxed); }
+	const std::atomic<bool> &CancelFlag() const { return cancelled; }
+
+	// Records from all workers in the order they were logged
+	std::vector<LogRecord> Drain();
+	ExportProgress Snapshot() const;
+
+private:
+	struct alignas(64) Worker {
+		LogRing log{4096};
+
+		std::atomic<uint64_t> items = 0;
+		std::atomic<uint64_t> bytes = 0;
+		std::atomic<uint64_t> dropped = 0;
+	};
+
+	std::vector<Worker> workers;
+
+	std::atomic<uint64_t> sequence = 0;
+	std::atomic<uint64_t> items_total = 0;
+	std::atomic<uint64_t> bytes_total = 0;
+
+	std::atomic<bool> cancelled = false;
+
+	Worker &Current();
+};
\ No newline at end of file
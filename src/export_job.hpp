@@ -0,0 +1,33 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <filesystem>
+#include <string>
+
+struct Paths {
+	std::filesystem::path input;
+	std::filesystem::path output;
+
+	Paths(std::filesystem::path input, std::filesystem::path output)
+		: input{input}, output{output}
+	{
+	}
+};
+
+struct ExportJob {
+	std::filesystem::path input_dir;
+	std::filesystem::path output_dir;
+
+	std::wstring name;
+	FORMAT format;
+
+	long long max_res;
+
+	QUALITY quality;
+	bool build_mipmaps;
+
+	WORKING_FORMAT working_format;
+
+	bool operator==(const ExportJob &) const = default;
+};
\ No newline at end of file
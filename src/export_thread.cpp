@@ -1,157 +1,373 @@
 #include "export_thread.hpp"
+#include "bc_encoder.hpp"
+#include "filter.hpp"
+#include "hash.hpp"
+#include "image_reader.hpp"
+#include "tiled.hpp"
 #include "nvtt/nvtt.h"
 #include "wx/log.h"
 
+#include <omp.h>
 #include <wx/wfstream.h>
 #include <wx/zipstrm.h>
 #include <wx/datstrm.h>
 
-#include <set>
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <memory>
 
-using namespace std::string_literals;
-
-static std::optional<nvtt::Format> GuessFormat(const std::filesystem::path &input,
-					       const nvtt::Surface &image)
+static nvtt::Quality ToNvttQuality(QUALITY quality)
 {
-	auto stem = input.stem().wstring();
+	switch (quality) {
+	case QUALITY_FASTEST:
+	case QUALITY_BUILTIN:
+		return nvtt::Quality_Fastest;
+	case QUALITY_HIGHEST:
+		return nvtt::Quality_Highest;
+	default:
+		return nvtt::Quality_Normal;
+	}
+}
 
-	if (stem.ends_with(L"_B")) {
-		return nvtt::Format_BC1;
-	} else if (stem.ends_with(L"_R")) {
-		return nvtt::Format_BC5;
-	} else if (stem.ends_with(L"_I")) {
-		return nvtt::Format_BC3;
-	} else if (stem.ends_with(L"_N")) {
-		return nvtt::Format_BC5;
-	} else if (stem.ends_with(L"_AO")) {
-		return nvtt::Format_BC1;
-	} else if (stem.ends_with(L"_DirtMask")) {
-		return nvtt::Format_BC1;
-	} else if (stem.ends_with(L"_D")) {
-		if (image.alphaMode() == nvtt::AlphaMode_None)
-			return nvtt::Format_BC1;
-		else
-			return nvtt::Format_BC3;
-	} else if (stem.ends_with(L"_H")) {
-		return nvtt::Format_BC1;
-	} else if (stem.ends_with(L"_M")) {
-		return nvtt::Format_BC3;
-	} else if (stem.ends_with(L"_L")) {
-		return nvtt::Format_BC3;
-	} else if (stem.ends_with(L"_CoatR")) {
-		return nvtt::Format_BC1;
+// Encodes one level into blocks without a header, with the built-in encoder
+// for QUALITY_BUILTIN and nvtt otherwise. Fails once the export is cancelled.
+static BlockEncoder MakeBlockEncoder(nvtt::Context &ctx, nvtt::Format format, QUALITY quality,
+				     const nvtt::CompressionOptions &compression_options,
+				     const ExportChannel &channel)
+{
+	if (quality == QUALITY_BUILTIN && IsBuiltinFormat(format)) {
+		return [format, &channel](const nvtt::Surface &surface,
+					  std::vector<uint8_t> &blocks) {
+			return !channel.Cancelled() && EncodeBlocks(surface, format, blocks);
+		};
 	}
 
-	return std::nullopt;
+	return [&ctx, &compression_options, &channel](const nvtt::Surface &surface,
+						      std::vector<uint8_t> &blocks) {
+		BufferHandler handler;
+		handler.cancelled = &channel.CancelFlag();
+
+		nvtt::OutputOptions output_options;
+		output_options.setOutputHandler(&handler);
+
+		if (!ctx.compress(surface, 0, 0, compression_options, output_options))
+			return false;
+
+		blocks.insert(blocks.end(), handler.buffer.begin(), handler.buffer.end());
+		return true;
+	};
 }
 
-static std::string FormatToString(nvtt::Format format)
+// Resizes and builds mips in unorm16, converting each level to float only to
+// hand it to the compressor. In compare mode the float path runs alongside and
+// the worst level's error is logged.
+static bool CompressImage16(nvtt::Context &ctx, const std::filesystem::path &input,
+			    nvtt::Surface &image, BufferHandler &output, const ExportJob &job,
+			    const nvtt::CompressionOptions &compression_options,
+			    const BlockEncoder &encode, ExportChannel &channel)
 {
-	switch (format) {
-	case nvtt::Format_BC1:
-		return "BC1"s;
-	case nvtt::Format_BC1a:
-		return "BC1a"s;
-	case nvtt::Format_BC2:
-		return "BC2"s;
-	case nvtt::Format_BC3:
-		return "BC3"s;
-	case nvtt::Format_BC3_RGBM:
-		return "BC3_RGBM"s;
-	case nvtt::Format_BC3n:
-		return "BC3n"s;
-	case nvtt::Format_BC4:
-		return "BC4"s;
-	case nvtt::Format_BC4S:
-		return "BC4S"s;
-	case nvtt::Format_BC5:
-		return "BC5"s;
-	case nvtt::Format_BC5S:
-		return "BC5S"s;
-	case nvtt::Format_BC7:
-		return "BC7"s;
-	default:
-		return "Unknown"s;
+	std::vector<nvtt::Surface> reference_chain;
+	if (job.working_format == WORKING_FORMAT_COMPARE) {
+		auto reference = image;
+		if (job.max_res > 0 &&
+		    (reference.width() > job.max_res || reference.height() > job.max_res))
+			reference.resize(job.max_res, nvtt::RoundMode_None, nvtt::ResizeFilter_Kaiser);
+
+		reference_chain = job.build_mipmaps ? BuildMipmapChain(reference)
+						    : std::vector<nvtt::Surface>{reference};
+	}
+
+	auto image16 = Image16::FromSurface(image);
+	image = nvtt::Surface{};
+
+	int width, height;
+	TargetExtent(image16.width, image16.height, job.max_res, width, height);
+	if (width != image16.width || height != image16.height)
+		image16 = Resize16(image16, width, height);
+
+	if (channel.Cancelled())
+		return false;
+
+	std::vector<Image16> chain;
+	if (job.build_mipmaps)
+		chain = BuildMipmapChain16(std::move(image16));
+	else
+		chain.push_back(std::move(image16));
+
+	if (channel.Cancelled())
+		return false;
+
+	nvtt::OutputOptions output_options;
+	output_options.setOutputHandler(&output);
+
+	SurfaceError worst{std::numeric_limits<double>::infinity(), 0.0};
+	bool mismatched = false;
+
+	for (int i = 0; i < chain.size(); ++i) {
+		auto level = chain[i].ToSurface();
+
+		if (i == 0 &&
+		    !ctx.outputHeader(level, chain.size(), compression_options, output_options))
+			return false;
+
+		if (!reference_chain.empty()) {
+			auto error = i < reference_chain.size()
+					     ? CompareSurfaces(reference_chain[i], level)
+					     : std::nullopt;
+
+			if (error.has_value()) {
+				worst.psnr = std::min(worst.psnr, error->psnr);
+				worst.max_error = std::max(worst.max_error, error->max_error);
+			} else {
+				mismatched = true;
+			}
+		}
+
+		if (!encode(level, output.buffer))
+			return false;
+	}
+
+	if (reference_chain.empty())
+		return true;
+
+	if (mismatched || chain.size() != reference_chain.size()) {
+		channel.Warning("= %ls (16-bit and float levels differ in size, not compared)",
+				input.filename().wstring());
+	} else {
+		channel.Message("= %ls (16-bit vs float: PSNR %.1f dB, max error %.5f)",
+				input.filename().wstring(), worst.psnr, worst.max_error);
 	}
+
+	return true;
 }
 
-static std::vector<nvtt::Surface> BuildMipmapChain(nvtt::Surface image)
+static bool CompressTiled(nvtt::Context &ctx, const std::filesystem::path &input,
+			  RowReader &reader, BufferHandler &output, const ExportJob &job,
+			  std::atomic<uint64_t> &pixels, ExportChannel &channel)
 {
-	std::vector<nvtt::Surface> chain;
-	chain.push_back(image);
+	auto format = GuessFormat(input, reader.has_alpha);
+	if (!format.has_value()) {
+		channel.Warning("Unable to guess format for %ls, skipping",
+				input.filename().wstring());
+		return false;
+	}
 
-	while (chain.back().canMakeNextMipmap()) {
-		chain.emplace_back(chain.back());
+	pixels += static_cast<uint64_t>(reader.width) * reader.height;
 
-		auto &image = chain.back();
+	int width, height;
+	TargetExtent(reader.width, reader.height, job.max_res, width, height);
 
-		image.toLinearFromSrgb();
-		image.premultiplyAlpha();
+	auto needs_resize = width != reader.width || height != reader.height;
+	channel.Message("+ %ls (%s, tiled, %s)", input.filename().wstring(),
+			FormatToString(format.value()), needs_resize ? "resizing" : "no resize");
 
-		image.buildNextMipmap(nvtt::MipmapFilter_Kaiser);
+	nvtt::CompressionOptions compression_options;
+	compression_options.setQuality(ToNvttQuality(job.quality));
+	compression_options.setFormat(format.value());
 
-		image.demultiplyAlpha();
-		image.toSrgb();
-	}
+	auto encode =
+		MakeBlockEncoder(ctx, format.value(), job.quality, compression_options, channel);
+
+	std::vector<std::vector<uint8_t>> levels;
+	if (!EncodeTiled(reader, width, height, job.build_mipmaps, encode, levels))
+		return false;
+
+	nvtt::OutputOptions output_options;
+	output_options.setOutputHandler(&output);
 
-	return chain;
+	if (!ctx.outputHeader(nvtt::TextureType_2D, width, height, 1, 1, levels.size(), false,
+			      compression_options, output_options))
+		return false;
+
+	for (auto &level : levels)
+		output.buffer.insert(output.buffer.end(), level.begin(), level.end());
+
+	return true;
 }
 
 static bool CompressImage(nvtt::Context &ctx, const std::filesystem::path input,
-			  const nvtt::OutputOptions &output_options, long long max_res,
-			  nvtt::Quality quality, bool build_mipmaps)
+			  BufferHandler &output, const ExportJob &job, const PlannedImage &planned,
+			  IncrementalCache *incremental_cache, std::atomic<uint64_t> &pixels,
+			  std::atomic<bool> &reused, ExportChannel &channel)
 {
+	auto max_res = job.max_res;
+	auto quality = job.quality;
+	auto build_mipmaps = job.build_mipmaps;
+
+	if (planned.tiled) {
+		if (auto reader = OpenRowReader(input)) {
+			return CompressTiled(ctx, input, *reader, output, job, pixels, channel);
+		}
+	}
+
 	nvtt::Surface image;
 	if (!image.load(input.string().c_str())) {
-		wxLogWarning("Unable to load %ls, skipping", input.filename().wstring());
+		channel.Warning("Unable to load %ls, skipping", input.filename().wstring());
 		return false;
 	}
 
+	if (channel.Cancelled())
+		return false;
+
 	auto format = GuessFormat(input, image);
 	if (!format.has_value()) {
-		wxLogWarning("Unable to guess format for %ls, skipping",
-			     input.filename().wstring());
+		channel.Warning("Unable to guess format for %ls, skipping",
+				input.filename().wstring());
 		return false;
 	}
 
+	auto source_pixels = static_cast<uint64_t>(image.width()) * image.height();
+
 	auto needs_resize = max_res > 0 && (image.width() > max_res || image.height() > max_res);
-	wxLogMessage("+ %ls (%s, %s)", input.filename().wstring(), FormatToString(format.value()),
-		     needs_resize ? "resizing" : "no resize");
+	channel.Message("+ %ls (%s, %s)", input.filename().wstring(),
+			FormatToString(format.value()), needs_resize ? "resizing" : "no resize");
+
+	nvtt::CompressionOptions compression_options;
+	compression_options.setQuality(ToNvttQuality(quality));
+	compression_options.setFormat(format.value());
+
+	auto encode = MakeBlockEncoder(ctx, format.value(), quality, compression_options, channel);
+
+	if (job.working_format != WORKING_FORMAT_FLOAT) {
+		pixels += source_pixels;
+		return CompressImage16(ctx, input, image, output, job, compression_options, encode,
+				       channel);
+	}
 
 	if (needs_resize)
 		image.resize(max_res, nvtt::RoundMode_None, nvtt::ResizeFilter_Kaiser);
 
+	if (channel.Cancelled())
+		return false;
+
+	auto previous = incremental_cache ? incremental_cache->Take(input) : nullptr;
+	if (previous && previous->Matches(format.value(), max_res, quality, build_mipmaps)) {
+		auto encoded = previous->Update(image, encode);
+		if (encoded.has_value()) {
+			channel.Message("~ %ls (%zu blocks re-encoded)", input.filename().wstring(),
+					encoded.value());
+
+			output.buffer = previous->dds;
+			incremental_cache->Store(input, std::move(previous));
+
+			reused = true;
+			return true;
+		}
+	}
+
+	pixels += source_pixels;
+
 	auto chain = build_mipmaps ? BuildMipmapChain(image) : std::vector<nvtt::Surface>{image};
 
-	nvtt::BatchList batch_list;
-	for (int i = 0; i < chain.size(); ++i)
-		batch_list.Append(&chain[i], 0, i, &output_options);
+	if (channel.Cancelled())
+		return false;
 
-	nvtt::CompressionOptions compression_options;
-	compression_options.setQuality(quality);
-	compression_options.setFormat(format.value());
+	nvtt::OutputOptions output_options;
+	output_options.setOutputHandler(&output);
+	output.cancelled = &channel.CancelFlag();
 
 	if (!ctx.outputHeader(chain.front(), chain.size(), compression_options, output_options))
 		return false;
 
-	if (!ctx.compress(batch_list, compression_options))
-		return false;
+	if (quality == QUALITY_BUILTIN) {
+		for (auto &level : chain) {
+			if (!encode(level, output.buffer))
+				return false;
+		}
+	} else {
+		nvtt::BatchList batch_list;
+		for (int i = 0; i < chain.size(); ++i)
+			batch_list.Append(&chain[i], 0, i, &output_options);
+
+		if (!ctx.compress(batch_list, compression_options))
+			return false;
+	}
+
+	if (incremental_cache &&
+	    incremental_cache->Fits(IncrementalEntry::BytesFor(chain, output.buffer.size()))) {
+		incremental_cache->Store(input, std::make_unique<IncrementalEntry>(
+							format.value(), max_res, quality,
+							build_mipmaps, chain, output.buffer));
+	}
 
 	return true;
 }
 
-ExportThread::ExportThread(wxEvtHandler *parent, std::filesystem::path input_dir,
-			   std::filesystem::path output_dir, std::wstring name, FORMAT format,
-			   long long max_res, nvtt::Quality quality, bool build_mipmaps)
+static bool WriteBuffer(const std::filesystem::path &path, const std::vector<uint8_t> &buffer)
+{
+	wxFFileOutputStream output_stream(path.wstring());
+	if (!output_stream.IsOk())
+		return false;
+
+	output_stream.Write(buffer.data(), buffer.size());
+
+	return output_stream.Close();
+}
+
+static std::string CacheSettings(const std::filesystem::path &input, const ExportJob &job)
+{
+	// GuessFormat only looks at the last "_X" of the stem, the rest of the
+	// name does not affect the output
+	auto stem = input.stem().wstring();
+	auto suffix = std::filesystem::path{stem.substr(std::min(stem.rfind(L'_'), stem.size()))};
+
+	return std::format("tm3-mod-exporter {} nvtt {} suffix {} max_res {} quality {} "
+			   "mipmaps {} working_format {}",
+			   TM3_EXPORTER_VERSION, NVTT_VERSION, suffix.string(), job.max_res,
+			   static_cast<int>(job.quality), job.build_mipmaps,
+			   static_cast<int>(job.working_format));
+}
+
+// Much cheaper than the content hash and enough for the journal, which only
+// has to notice inputs edited since their checkpoint was written
+static std::optional<std::string> CheckpointKey(const std::filesystem::path &input,
+						const ExportJob &job)
+{
+	std::error_code ec;
+	auto size = std::filesystem::file_size(input, ec);
+	if (ec)
+		return std::nullopt;
+
+	auto time = std::filesystem::last_write_time(input, ec);
+	if (ec)
+		return std::nullopt;
+
+	Sha256 hash;
+	hash.Update(std::format("{} {} {}", size, time.time_since_epoch().count(),
+				CacheSettings(input, job)));
+
+	return hash.HexDigest();
+}
+
+static std::filesystem::path CheckpointDir(const std::filesystem::path &root,
+					   const ExportJob &job)
+{
+	auto output = (job.output_dir / job.name).generic_u8string();
+
+	Sha256 hash;
+	hash.Update(output.data(), output.size());
+
+	return root / hash.HexDigest().substr(0, 16);
+}
+
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+ExportThread::ExportThread(wxEvtHandler *parent, std::vector<ExportJob> jobs,
+			   IncrementalCache *incremental_cache, CacheOptions cache_options,
+			   EngineOptions engine_options, std::optional<ExportPlan> plan)
 	: wxThread(wxTHREAD_JOINABLE),
 	  parent{parent},
-	  input_dir{input_dir},
-	  output_dir{output_dir},
-	  name{name},
-	  format{format},
-	  max_res{max_res},
-	  quality{quality},
-	  build_mipmaps{build_mipmaps}
+	  jobs{std::move(jobs)},
+	  incremental_cache{incremental_cache},
+	  cache_options{std::move(cache_options)},
+	  engine_options{engine_options},
+	  channel{WorkerCount(engine_options)},
+	  plan{std::move(plan)}
 {
 }
 
@@ -159,123 +375,316 @@ ExportThread::ExitCode ExportThread::Entry()
 {
 	ctx.enableCudaAcceleration(true);
 
-	std::vector<Paths> paths;
-	std::set<std::filesystem::path> output_dirs;
+	auto start = std::chrono::steady_clock::now();
+
+	if (!cache_options.dir.empty()) {
+		cache_store = std::make_unique<DirectoryCacheStore>(cache_options.dir,
+								    cache_options.max_bytes);
+	}
+
+	// Inputs may have changed since the plan was made, only unchanged ones
+	// keep their planned entries
+	plan = PlanExport(jobs, WorkerCount(engine_options),
+			  incremental_cache ? incremental_cache->MaxBytes() : 0, {},
+			  plan.has_value() ? &plan.value() : nullptr);
+
+	std::vector<std::unique_ptr<JobState>> states;
+	std::vector<std::pair<JobState *, size_t>> items;
+
+	uint64_t progress_items = 0;
+	uint64_t progress_bytes = 0;
+
+	for (size_t j = 0; j < jobs.size(); ++j) {
+		auto &job = jobs[j];
+		auto &job_plan = plan->job_plans[j];
+
+		for (auto &duplicate : job_plan.duplicates) {
+			channel.Warning("Duplicate input stem \"%s\", skipping",
+					duplicate.stem().string());
+		}
+
+		auto &state = states.emplace_back(std::make_unique<JobState>(job, job_plan));
+
+		state->checkpoint = std::make_unique<Checkpoint>(
+			CheckpointDir(cache_options.checkpoint_dir, job));
+
+		if (state->checkpoint->Size() > 0) {
+			channel.Message("Resuming %ls from a checkpoint of %zu images", job.name,
+					state->checkpoint->Size());
+		}
+
+		for (size_t i = 0; i < state->paths.size(); ++i)
+			items.push_back({state.get(), i});
+
+		progress_bytes += job_plan.input_bytes;
+
+		if (job.format == FORMAT_ARCHIVE) {
+			state->buffers.resize(state->paths.size());
+			progress_items += state->paths.size();
+		} else if (job.format == FORMAT_FOLDER) {
+			for (auto &[_, output_file] : state->paths) {
+				auto output_path = job.output_dir;
+				output_path /= job.name;
+				output_path /= output_file;
 
-	for (auto entry : std::filesystem::recursive_directory_iterator(input_dir)) {
-		if (!entry.is_regular_file())
-			continue;
+				std::filesystem::create_directories(output_path.parent_path());
+			}
+		}
 
-		auto input_file = entry.path();
+		progress_items += state->paths.size();
+	}
 
-		if (!input_extensions.contains(input_file.extension().string()))
-			continue;
+	channel.SetTotals(progress_items, progress_bytes);
 
-		auto output_file = input_file.lexically_relative(input_dir);
-		output_file.replace_extension("dds");
+	channel.Message("Starting export of %zu job(s), %zu images on %s", jobs.size(),
+			items.size(), DescribeEngine(engine_options));
 
-		for (auto &[_, output_file2] : paths) {
-			if (output_file == output_file2)
-				wxLogWarning("Duplicate input stem \"%s\", skipping",
-					     input_file.stem().string());
-			continue;
+	for (auto &state : states) {
+		if (state->paths.empty()) {
+			state->start = std::chrono::steady_clock::now();
+			FinishJob(*state);
 		}
+	}
+
+	auto compress_start = std::chrono::steady_clock::now();
+
+	// One flat work list across all jobs: whichever thread finishes the last
+	// image of a job writes its archive while the others move on to the next
+#pragma omp parallel num_threads(WorkerCount(engine_options))
+	{
+		ApplyWorkerSettings(engine_options, omp_get_thread_num());
+
+#pragma omp for schedule(dynamic)
+		for (int i = 0; i < items.size(); ++i) {
+			auto &[state, index] = items[i];
 
-		output_dirs.insert(output_file.parent_path());
-		paths.push_back({input_file, output_file});
+			// OpenMP 2.0 cannot break out of a loop, the rest is skipped
+			if (channel.Cancelled())
+				continue;
+
+			if (!state->started.exchange(true))
+				state->start = std::chrono::steady_clock::now();
+
+			if (!ExportImage(*state, index))
+				continue;
+
+			if (state->remaining.fetch_sub(1) == 1)
+				FinishJob(*state);
+		}
 	}
 
-	wxLogMessage("Starting export");
-	if (format == FORMAT_ARCHIVE)
-		ExportArchive(paths);
-	else if (format == FORMAT_FOLDER)
-		ExportFolder(paths);
+	auto compress_seconds = SecondsSince(compress_start);
+
+	if (channel.Cancelled()) {
+		channel.Warning("Export cancelled after %.2fs, run it again with the same "
+				"settings to resume", SecondsSince(start));
+
+		wxQueueEvent(parent, new wxThreadEvent(EVT_EXPORT_FINISHED));
+		return 0;
+	}
+
+	channel.Message("Export finished in %.2fs, %.1f MPix/s compressed (%s)",
+			SecondsSince(start), pixels / 1e6 / std::max(compress_seconds, 1e-3),
+			DescribeEngine(engine_options));
+
+	// Only exports of one setting say anything about that setting, and short
+	// ones are mostly startup. Any image taken from a cache or a checkpoint
+	// would count its time but not its pixels
+	auto key = CalibrationKey(jobs.front(), WorkerCount(engine_options));
+	auto same_settings = std::all_of(jobs.begin(), jobs.end(), [&](auto &job) {
+		return CalibrationKey(job, WorkerCount(engine_options)) == key;
+	});
+
+	if (same_settings && !reused && compress_seconds >= 1.0 && pixels > 0)
+		sample = CalibrationSample{key, pixels / 1e6 / compress_seconds};
 
 	wxQueueEvent(parent, new wxThreadEvent(EVT_EXPORT_FINISHED));
-	wxLogMessage("Export finished");
 
 	return 0;
 }
 
-void ExportThread::ExportArchive(const std::vector<Paths> &paths)
+bool ExportThread::CompressCached(const std::filesystem::path &input, BufferHandler &output,
+				  const ExportJob &job, const PlannedImage &planned)
 {
-	auto progress_range_event = new wxThreadEvent(EVT_EXPORT_PROGRESS_RANGE);
-	progress_range_event->SetInt(paths.size());
-	wxQueueEvent(parent, progress_range_event);
+	if (!cache_store) {
+		return CompressImage(ctx, input, output, job, planned, incremental_cache, pixels,
+				     reused, channel);
+	}
 
-	std::vector<BufferHandler> buffers{paths.size()};
+	auto key = ComputeCacheKey(input, CacheSettings(input, job));
+	if (!key.has_value()) {
+		return CompressImage(ctx, input, output, job, planned, incremental_cache, pixels,
+				     reused, channel);
+	}
 
-#pragma omp parallel for
-	for (int i = 0; i < paths.size(); ++i) {
-		nvtt::OutputOptions output_options;
-		output_options.setOutputHandler(&buffers[i]);
+	if (auto data = cache_store->Get(key.value())) {
+		channel.Message("* %ls (cached)", input.filename().wstring());
 
-		auto success = CompressImage(ctx, paths[i].input, output_options, max_res, quality,
-					     build_mipmaps);
-		if (!success) {
-			wxLogError("Error compressing %ls -> %ls", paths[i].input.c_str(),
-				   paths[i].output.c_str());
-		}
+		output.buffer = std::move(data.value());
+		reused = true;
 
-		wxQueueEvent(parent, new wxThreadEvent(EVT_EXPORT_PROGRESS));
+		return true;
 	}
 
-	std::filesystem::create_directories(output_dir);
+	if (!CompressImage(ctx, input, output, job, planned, incremental_cache, pixels, reused,
+			   channel))
+		return false;
 
-	auto output_zip = output_dir;
-	output_zip /= name;
-	output_zip.replace_extension(".zip");
+	cache_store->Put(key.value(), output.buffer);
 
-	wxLogMessage("Archiving...");
+	return true;
+}
+
+bool ExportThread::ResumeImage(JobState &state, size_t index, const std::string &key)
+{
+	auto &job = state.job;
+	auto &paths = state.paths[index];
+
+	if (!state.checkpoint->Has(paths.output, key))
+		return false;
+
+	if (job.format == FORMAT_ARCHIVE) {
+		std::ifstream file(state.checkpoint->PathFor(paths.output),
+				   std::ios::binary | std::ios::ate);
+		if (!file)
+			return false;
+
+		auto &buffer = state.buffers[index].buffer;
+		buffer.resize(static_cast<size_t>(file.tellg()));
+
+		file.seekg(0);
+		if (!file.read(reinterpret_cast<char *>(buffer.data()), buffer.size()))
+			return false;
+	} else if (job.format == FORMAT_FOLDER) {
+		std::error_code ec;
+		if (!std::filesystem::exists(job.output_dir / job.name / paths.output, ec))
+			return false;
+	}
 
-	wxQueueEvent(parent, new wxThreadEvent(EVT_EXPORT_PROGRESS_RESET));
+	channel.Message("> %ls (checkpoint)", paths.input.filename().wstring());
+	reused = true;
 
-	wxFFileOutputStream output_stream(output_zip.wstring());
-	wxZipOutputStream zip_stream(output_stream);
-	wxDataOutputStream data_stream(zip_stream);
+	return true;
+}
 
-	for (int i = 0; i < paths.size(); ++i) {
-		auto &buffer = buffers[i].buffer;
+bool ExportThread::ExportImage(JobState &state, size_t index)
+{
+	auto &job = state.job;
+	auto &paths = state.paths[index];
 
-		zip_stream.PutNextEntry(paths[i].output.wstring());
-		data_stream.Write8(buffer.data(), buffer.size());
+	auto key = CheckpointKey(paths.input, job);
 
-		wxQueueEvent(parent, new wxThreadEvent(EVT_EXPORT_PROGRESS));
+	if (key.has_value() && ResumeImage(state, index, key.value())) {
+		channel.Progress(1, state.plan.images[index].input_bytes);
+		return true;
 	}
 
-	zip_stream.Close();
+	auto output_path = job.output_dir;
+	output_path /= job.name;
+	output_path /= paths.output;
+
+	auto checkpoint_path = state.checkpoint->PathFor(paths.output);
+
+	bool success = false;
+
+	if (job.format == FORMAT_ARCHIVE) {
+		auto &buffer = state.buffers[index];
+		success = CompressCached(paths.input, buffer, job, state.plan.images[index]);
+
+		// The archive is only written once every image is done, until then
+		// the checkpoint copy is what survives a cancel or a crash
+		if (success && key.has_value()) {
+			std::error_code ec;
+			std::filesystem::create_directories(checkpoint_path.parent_path(), ec);
+
+			if (WriteBuffer(checkpoint_path, buffer.buffer))
+				state.checkpoint->Record(paths.output, key.value());
+		}
+	} else if (job.format == FORMAT_FOLDER) {
+		BufferHandler buffer;
+		success = CompressCached(paths.input, buffer, job, state.plan.images[index]) &&
+			  WriteBuffer(output_path, buffer.buffer);
+
+		if (success && key.has_value())
+			state.checkpoint->Record(paths.output, key.value());
+	}
+
+	if (!success) {
+		if (channel.Cancelled())
+			return false;
+
+		channel.Error("Error compressing %ls -> %ls", paths.input.c_str(),
+			      job.format == FORMAT_ARCHIVE ? paths.output.c_str()
+							   : output_path.c_str());
+	}
+
+	channel.Progress(1, state.plan.images[index].input_bytes);
+
+	return true;
 }
 
-void ExportThread::ExportFolder(const std::vector<Paths> &paths)
+void ExportThread::FinishJob(JobState &state)
 {
-	for (auto &[_, output_file] : paths) {
-		auto output_path = output_dir;
-		output_path /= name;
-		output_path /= output_file;
+	if (state.job.format == FORMAT_ARCHIVE && !WriteArchive(state))
+		return;
 
-		std::filesystem::create_directories(output_path.parent_path());
-	}
+	state.checkpoint->Remove();
+
+	channel.Message("Finished %ls: %zu images in %.2fs", state.job.name, state.paths.size(),
+			SecondsSince(state.start));
+}
 
-	auto progress_range_event = new wxThreadEvent(EVT_EXPORT_PROGRESS_RANGE);
-	progress_range_event->SetInt(paths.size());
-	wxQueueEvent(parent, progress_range_event);
+bool ExportThread::WriteArchive(JobState &state)
+{
+	auto &job = state.job;
 
-#pragma omp parallel for
-	for (int i = 0; i < paths.size(); ++i) {
-		auto output_path = output_dir;
-		output_path /= name;
-		output_path /= paths[i].output;
+	std::filesystem::create_directories(job.output_dir);
 
-		nvtt::OutputOptions output_options;
-		output_options.setFileName(output_path.string().c_str());
+	auto output_zip = job.output_dir;
+	output_zip /= job.name;
+	output_zip.replace_extension(".zip");
+
+	channel.Message("Archiving %ls...", job.name);
+
+	// The previous archive stays in place until the new one is complete
+	auto temp_zip = output_zip;
+	temp_zip += ".tmp";
+
+	bool complete = false;
+
+	{
+		wxFFileOutputStream output_stream(temp_zip.wstring());
+		wxZipOutputStream zip_stream(output_stream);
+		wxDataOutputStream data_stream(zip_stream);
 
-		auto success = CompressImage(ctx, paths[i].input, output_options, max_res, quality,
-					     build_mipmaps);
-		if (!success) {
-			wxLogError("Error compressing %ls -> %ls", paths[i].input.c_str(),
-				   output_path.c_str());
+		size_t i = 0;
+		for (; i < state.paths.size() && !channel.Cancelled(); ++i) {
+			auto &buffer = state.buffers[i].buffer;
+
+			zip_stream.PutNextEntry(state.paths[i].output.wstring());
+			data_stream.Write8(buffer.data(), buffer.size());
+
+			channel.Progress(1, 0);
 		}
 
-		wxQueueEvent(parent, new wxThreadEvent(EVT_EXPORT_PROGRESS));
+		complete = i == state.paths.size() && zip_stream.Close() && output_stream.Close();
 	}
+
+	std::error_code ec;
+	if (complete)
+		std::filesystem::rename(temp_zip, output_zip, ec);
+
+	if (!complete || ec) {
+		std::filesystem::remove(temp_zip, ec);
+
+		if (!channel.Cancelled())
+			channel.Error("Error writing %ls", output_zip.c_str());
+
+		return false;
+	}
+
+	state.buffers.clear();
+	state.buffers.shrink_to_fit();
+
+	return true;
 }
\ No newline at end of file
@@ -1,64 +1,97 @@
 #pragma once
 
+#include "checkpoint.hpp"
 #include "common.hpp"
+#include "compression_cache.hpp"
+#include "engine.hpp"
+#include "export_channel.hpp"
+#include "export_job.hpp"
+#include "incremental.hpp"
+#include "planner.hpp"
+#include "texture.hpp"
 
 #include <nvtt/nvtt.h>
 #include <wx/wx.h>
 
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
-struct Paths {
-	std::filesystem::path input;
-	std::filesystem::path output;
+struct CacheOptions {
+	std::filesystem::path dir;
+	uint64_t max_bytes = 0;
 
-	Paths(std::filesystem::path input, std::filesystem::path output)
-		: input{input}, output{output}
-	{
-	}
+	// Holds each job's checkpoint journal, and the outputs of archive jobs
+	// until their archive is written
+	std::filesystem::path checkpoint_dir;
 };
 
-struct BufferHandler : nvtt::OutputHandler {
-	~BufferHandler() = default;
+struct JobState {
+	const ExportJob &job;
+	const JobPlan &plan;
+	const std::vector<Paths> &paths;
+	std::vector<BufferHandler> buffers;
 
-	void beginImage(int size, int width, int height, int depth, int face, int miplevel) {}
-	void endImage() {}
+	std::unique_ptr<Checkpoint> checkpoint;
 
-	bool writeData(const void *data, int size)
-	{
-		auto data2 = reinterpret_cast<const uint8_t *>(data);
-		buffer.insert(buffer.end(), data2, &data2[size]);
+	std::atomic<size_t> remaining;
 
-		return true;
-	}
+	std::atomic<bool> started = false;
+	std::chrono::steady_clock::time_point start;
 
-	std::vector<uint8_t> buffer;
+	JobState(const ExportJob &job, const JobPlan &plan)
+		: job{job}, plan{plan}, paths{plan.paths}, remaining{plan.paths.size()}
+	{
+	}
 };
 
 class ExportThread : public wxThread {
 public:
-	ExportThread(wxEvtHandler *parent, std::filesystem::path input_dir,
-		     std::filesystem::path output_dir, std::wstring name, FORMAT format,
-		     long long max_res, nvtt::Quality quality, bool build_mipmaps);
+	ExportThread(wxEvtHandler *parent, std::vector<ExportJob> jobs,
+		     IncrementalCache *incremental_cache, CacheOptions cache_options,
+		     EngineOptions engine_options, std::optional<ExportPlan> plan);
+
+	ExportChannel &Channel() { return channel; }
+
+	// Throughput of a finished export, if it is worth calibrating plans with
+	std::optional<CalibrationSample> Sample() const { return sample; }
 
 private:
 	nvtt::Context ctx{};
 
 	wxEvtHandler *parent;
 
-	std::filesystem::path input_dir;
-	std::filesystem::path output_dir;
+	std::vector<ExportJob> jobs;
+
+	IncrementalCache *incremental_cache;
 
-	std::wstring name;
-	FORMAT format;
+	CacheOptions cache_options;
+	std::unique_ptr<CacheStore> cache_store;
 
-	long long max_res;
+	EngineOptions engine_options;
+	ExportChannel channel;
 
-	nvtt::Quality quality;
-	bool build_mipmaps;
+	std::optional<ExportPlan> plan;
+	std::optional<CalibrationSample> sample;
+
+	// Source texels of every image compressed (not cached) in this export
+	std::atomic<uint64_t> pixels = 0;
+
+	// Set once any image comes from a cache or a checkpoint instead
+	std::atomic<bool> reused = false;
 
 	virtual ExitCode Entry();
 
-	void ExportArchive(const std::vector<Paths> &paths);
-	void ExportFolder(const std::vector<Paths> &paths);
+	bool CompressCached(const std::filesystem::path &input, BufferHandler &output,
+			    const ExportJob &job, const PlannedImage &planned);
+	bool ResumeImage(JobState &state, size_t index, const std::string &key);
+
+	// Returns false if the export was cancelled before the image was done
+	bool ExportImage(JobState &state, size_t index);
+	void FinishJob(JobState &state);
+	bool WriteArchive(JobState &state);
 };
\ No newline at end of file
@@ -0,0 +1,695 @@
+#include "filter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define FILTER_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef FILTER_SSE2
+using Vec4 = __m128;
+
+static inline Vec4 Splat(float f)
+{
+	return _mm_set1_ps(f);
+}
+
+static inline Vec4 Set(float x, float y, float z, float w)
+{
+	return _mm_setr_ps(x, y, z, w);
+}
+
+static inline Vec4 Add(Vec4 a, Vec4 b)
+{
+	return _mm_add_ps(a, b);
+}
+
+static inline Vec4 Mul(Vec4 a, Vec4 b)
+{
+	return _mm_mul_ps(a, b);
+}
+
+static inline Vec4 Div(Vec4 a, Vec4 b)
+{
+	return _mm_div_ps(a, b);
+}
+
+static inline Vec4 Alpha(Vec4 v)
+{
+	return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+static inline Vec4 Load(const float *ptr)
+{
+	return _mm_loadu_ps(ptr);
+}
+
+static inline void Store(float *ptr, Vec4 v)
+{
+	_mm_storeu_ps(ptr, v);
+}
+
+static inline Vec4 LoadTexel(const uint16_t *texel)
+{
+	auto v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(texel));
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+}
+
+static inline void StoreTexel(uint16_t *texel, Vec4 v)
+{
+	v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(65535.0f));
+
+	// No unsigned 32->16 pack before SSE4.1, so bias into signed range and back
+	auto i = _mm_sub_epi32(_mm_cvtps_epi32(v), _mm_set1_epi32(32768));
+	i = _mm_add_epi16(_mm_packs_epi32(i, i), _mm_set1_epi16(-32768));
+
+	_mm_storel_epi64(reinterpret_cast<__m128i *>(texel), i);
+}
+#else
+struct Vec4 {
+	float v[4];
+};
+
+static inline Vec4 Splat(float f)
+{
+	return {f, f, f, f};
+}
+
+static inline Vec4 Set(float x, float y, float z, float w)
+{
+	return {x, y, z, w};
+}
+
+static inline Vec4 Add(Vec4 a, Vec4 b)
+{
+	return {a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]};
+}
+
+static inline Vec4 Mul(Vec4 a, Vec4 b)
+{
+	return {a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]};
+}
+
+static inline Vec4 Div(Vec4 a, Vec4 b)
+{
+	return {a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]};
+}
+
+static inline Vec4 Alpha(Vec4 v)
+{
+	return Splat(v.v[3]);
+}
+
+static inline Vec4 Load(const float *ptr)
+{
+	return {ptr[0], ptr[1], ptr[2], ptr[3]};
+}
+
+static inline void Store(float *ptr, Vec4 v)
+{
+	std::copy(v.v, v.v + 4, ptr);
+}
+
+static inline Vec4 LoadTexel(const uint16_t *texel)
+{
+	return {float(texel[0]), float(texel[1]), float(texel[2]), float(texel[3])};
+}
+
+static inline void StoreTexel(uint16_t *texel, Vec4 v)
+{
+	for (int c = 0; c < 4; ++c)
+		texel[c] = static_cast<uint16_t>(std::lround(std::clamp(v.v[c], 0.0f, 65535.0f)));
+}
+#endif
+
+static constexpr float kaiser_width = 3.0f;
+static constexpr float kaiser_alpha = 4.0f;
+static constexpr float kaiser_stretch = 1.0f;
+static constexpr float pi = 3.14159265358979f;
+
+static float Bessel0(float x)
+{
+	float sum = 1.0f;
+	float term = 1.0f;
+
+	for (int k = 1; term > sum * 1e-8f; ++k) {
+		auto half = x / (2.0f * k);
+		term *= half * half;
+		sum += term;
+	}
+
+	return sum;
+}
+
+static float Sinc(float x)
+{
+	if (std::fabs(x) < 1e-4f)
+		return 1.0f - x * x / 6.0f;
+
+	return std::sin(x) / x;
+}
+
+static float Kaiser(float x)
+{
+	auto t = x / kaiser_width;
+	if (1.0f - t * t < 0.0f)
+		return 0.0f;
+
+	return Sinc(pi * x * kaiser_stretch) * Bessel0(kaiser_alpha * std::sqrt(1.0f - t * t)) /
+	       Bessel0(kaiser_alpha);
+}
+
+static int Mirror(int x, int length)
+{
+	if (length == 1)
+		return 0;
+
+	x = std::abs(x);
+	while (x >= length)
+		x = std::abs(2 * length - x - 2);
+
+	return x;
+}
+
+// Polyphase kernel built the same way as nvtt's: box-sampled filter taps,
+// normalised, with source indices already mirrored at the edges
+struct Kernel {
+	int window;
+	std::vector<int> indices;
+	std::vector<float> weights;
+
+	Kernel(int src_length, int dst_length)
+	{
+		auto scale = float(dst_length) / float(src_length);
+		auto iscale = 1.0f / scale;
+		auto samples = 32;
+
+		if (scale > 1.0f) {
+			samples = 1;
+			scale = 1.0f;
+		}
+
+		auto width = kaiser_width * iscale;
+		window = static_cast<int>(std::ceil(width * 2.0f)) + 1;
+
+		indices.resize(static_cast<size_t>(dst_length) * window);
+		weights.resize(static_cast<size_t>(dst_length) * window);
+
+		for (int i = 0; i < dst_length; ++i) {
+			auto center = (0.5f + i) * iscale;
+			auto left = static_cast<int>(std::floor(center - width));
+
+			float total = 0.0f;
+			for (int j = 0; j < window; ++j) {
+				auto x = left + j - center;
+
+				float sample = 0.0f;
+				for (int s = 0; s < samples; ++s)
+					sample += Kaiser((x + (s + 0.5f) / samples) * scale);
+
+				sample /= samples;
+
+				indices[i * window + j] = Mirror(left + j, src_length);
+				weights[i * window + j] = sample;
+				total += sample;
+			}
+
+			for (int j = 0; j < window; ++j)
+				weights[i * window + j] /= total;
+		}
+	}
+};
+
+// With alpha weighting, colour taps are scaled by alpha (plus a small bias so
+// fully transparent regions still average), matching nvtt's resize of images
+// in AlphaMode_Transparency
+struct TapWeight {
+	Vec4 scale;
+	Vec4 bias;
+
+	TapWeight(bool alpha_weighted)
+	{
+		if (alpha_weighted) {
+			auto s = 1.0f / 65535.0f;
+			auto b = 1.0f / 256.0f;
+
+			scale = Set(s, s, s, 0.0f);
+			bias = Set(b, b, b, 1.0f);
+		} else {
+			scale = Splat(0.0f);
+			bias = Splat(1.0f);
+		}
+	}
+
+	Vec4 operator()(Vec4 texel, float k) const
+	{
+		return Mul(Splat(k), Add(Mul(Alpha(texel), scale), bias));
+	}
+};
+
+static void ResampleRowX(const uint16_t *src, uint16_t *dst, int width, const Kernel &kernel,
+			 const TapWeight &tap_weight)
+{
+	for (int x = 0; x < width; ++x) {
+		auto indices = &kernel.indices[static_cast<size_t>(x) * kernel.window];
+		auto weights = &kernel.weights[static_cast<size_t>(x) * kernel.window];
+
+		auto sum = Splat(0.0f);
+		auto norm = Splat(0.0f);
+
+		for (int j = 0; j < kernel.window; ++j) {
+			auto texel = LoadTexel(&src[indices[j] * 4]);
+			auto weight = tap_weight(texel, weights[j]);
+
+			sum = Add(sum, Mul(weight, texel));
+			norm = Add(norm, weight);
+		}
+
+		StoreTexel(&dst[x * 4], Div(sum, norm));
+	}
+}
+
+// Whole source rows are accumulated at once so every tap streams through
+// memory linearly. rows holds the window's source rows in kernel order.
+static void ResampleRowY(const uint16_t *const *rows, const float *weights, uint16_t *dst,
+			 int width, int window, const TapWeight &tap_weight,
+			 std::vector<float> &sum, std::vector<float> &norm)
+{
+	sum.assign(static_cast<size_t>(width) * 4, 0.0f);
+	norm.assign(static_cast<size_t>(width) * 4, 0.0f);
+
+	for (int j = 0; j < window; ++j) {
+		auto src = rows[j];
+		auto k = weights[j];
+
+		for (int x = 0; x < width; ++x) {
+			auto texel = LoadTexel(&src[x * 4]);
+			auto weight = tap_weight(texel, k);
+
+			Store(&sum[x * 4], Add(Load(&sum[x * 4]), Mul(weight, texel)));
+			Store(&norm[x * 4], Add(Load(&norm[x * 4]), weight));
+		}
+	}
+
+	for (int x = 0; x < width; ++x)
+		StoreTexel(&dst[x * 4], Div(Load(&sum[x * 4]), Load(&norm[x * 4])));
+}
+
+static Image16 ResampleX(const Image16 &image, int width, bool alpha_weighted)
+{
+	Image16 result{width, image.height, image.alpha_mode};
+
+	Kernel kernel{image.width, width};
+	TapWeight tap_weight{alpha_weighted};
+
+	for (int y = 0; y < image.height; ++y) {
+		ResampleRowX(&image.texels[static_cast<size_t>(y) * image.width * 4],
+			     &result.texels[static_cast<size_t>(y) * width * 4], width, kernel,
+			     tap_weight);
+	}
+
+	return result;
+}
+
+static Image16 ResampleY(const Image16 &image, int height, bool alpha_weighted)
+{
+	Image16 result{image.width, height, image.alpha_mode};
+
+	Kernel kernel{image.height, height};
+	TapWeight tap_weight{alpha_weighted};
+
+	std::vector<const uint16_t *> rows(kernel.window);
+	std::vector<float> sum;
+	std::vector<float> norm;
+
+	for (int y = 0; y < height; ++y) {
+		for (int j = 0; j < kernel.window; ++j) {
+			auto row = kernel.indices[static_cast<size_t>(y) * kernel.window + j];
+			rows[j] = &image.texels[static_cast<size_t>(row) * image.width * 4];
+		}
+
+		ResampleRowY(rows.data(), &kernel.weights[static_cast<size_t>(y) * kernel.window],
+			     &result.texels[static_cast<size_t>(y) * image.width * 4], image.width,
+			     kernel.window, tap_weight, sum, norm);
+	}
+
+	return result;
+}
+
+static Image16 Resample(const Image16 &image, int width, int height, bool alpha_weighted)
+{
+	if (image.width == width)
+		return ResampleY(image, height, alpha_weighted);
+
+	auto resampled = ResampleX(image, width, alpha_weighted);
+	if (image.height == height)
+		return resampled;
+
+	return ResampleY(resampled, height, alpha_weighted);
+}
+
+class ResampleStream : public RowStream {
+public:
+	ResampleStream(int src_width, int src_height, int dst_width, int dst_height,
+		       bool alpha_weighted, RowSink sink)
+		: dst_width{dst_width},
+		  dst_height{dst_height},
+		  tap_weight{alpha_weighted},
+		  sink{std::move(sink)},
+		  row(static_cast<size_t>(dst_width) * 4)
+	{
+		// Same passes as Resample
+		if (src_width != dst_width)
+			x_kernel.emplace(src_width, dst_width);
+
+		if (src_width == dst_width || src_height != dst_height)
+			y_kernel.emplace(src_height, dst_height);
+
+		if (!y_kernel.has_value())
+			return;
+
+		// Output rows are made as soon as their last tap arrives, the ring
+		// has to reach back from there to their first tap
+		auto window = y_kernel->window;
+		int pushed = 0;
+
+		for (int y = 0; y < dst_height; ++y) {
+			auto taps = &y_kernel->indices[static_cast<size_t>(y) * window];
+			auto [first, last] = std::minmax_element(taps, taps + window);
+
+			pushed = std::max(pushed, *last + 1);
+			capacity = std::max(capacity, pushed - *first);
+		}
+
+		ring.resize(static_cast<size_t>(capacity) * dst_width * 4);
+		rows.resize(window);
+	}
+
+	bool Push(const uint16_t *src) override
+	{
+		if (next_row >= dst_height)
+			return true;
+
+		auto dst = y_kernel.has_value() ? RingRow(pushed) : row.data();
+
+		if (x_kernel.has_value())
+			ResampleRowX(src, dst, dst_width, x_kernel.value(), tap_weight);
+		else
+			std::copy(src, src + static_cast<size_t>(dst_width) * 4, dst);
+
+		++pushed;
+
+		if (!y_kernel.has_value()) {
+			++next_row;
+			return sink(dst);
+		}
+
+		auto window = y_kernel->window;
+
+		while (next_row < dst_height) {
+			auto taps = &y_kernel->indices[static_cast<size_t>(next_row) * window];
+			if (*std::max_element(taps, taps + window) >= pushed)
+				break;
+
+			for (int j = 0; j < window; ++j)
+				rows[j] = RingRow(taps[j]);
+
+			ResampleRowY(rows.data(),
+				     &y_kernel->weights[static_cast<size_t>(next_row) * window],
+				     row.data(), dst_width, window, tap_weight, sum, norm);
+
+			++next_row;
+
+			if (!sink(row.data()))
+				return false;
+		}
+
+		return true;
+	}
+
+private:
+	int dst_width;
+	int dst_height;
+
+	std::optional<Kernel> x_kernel;
+	std::optional<Kernel> y_kernel;
+	TapWeight tap_weight;
+
+	RowSink sink;
+
+	int capacity = 0;
+	int pushed = 0;
+	int next_row = 0;
+
+	std::vector<uint16_t> ring;
+	std::vector<uint16_t> row;
+	std::vector<const uint16_t *> rows;
+	std::vector<float> sum;
+	std::vector<float> norm;
+
+	uint16_t *RingRow(int source_row)
+	{
+		return &ring[static_cast<size_t>(source_row % capacity) * dst_width * 4];
+	}
+};
+
+static float SrgbToLinear(float f)
+{
+	if (f < 0.04045f)
+		return f / 12.92f;
+
+	return std::pow((f + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSrgb(float f)
+{
+	if (!(f > 0.0f))
+		return 0.0f;
+	else if (f <= 0.0031308f)
+		return 12.92f * f;
+	else if (f <= 1.0f)
+		return std::pow(f, 1.0f / 2.4f) * 1.055f - 0.055f;
+
+	return 1.0f;
+}
+
+struct TransferTables {
+	std::vector<uint16_t> to_linear;
+	std::vector<uint16_t> to_srgb;
+
+	TransferTables() : to_linear(65536), to_srgb(65536)
+	{
+		for (int i = 0; i < 65536; ++i) {
+			auto f = i / 65535.0f;
+
+			to_linear[i] = static_cast<uint16_t>(std::lround(SrgbToLinear(f) * 65535.0f));
+			to_srgb[i] = static_cast<uint16_t>(std::lround(LinearToSrgb(f) * 65535.0f));
+		}
+	}
+};
+
+static const TransferTables &Tables()
+{
+	static const TransferTables tables;
+	return tables;
+}
+
+Image16 Image16::FromSurface(const nvtt::Surface &surface)
+{
+	Image16 image{surface.width(), surface.height(), surface.alphaMode()};
+
+	size_t count = static_cast<size_t>(image.width) * image.height;
+	for (int c = 0; c < 4; ++c) {
+		auto channel = surface.channel(c);
+
+		for (size_t i = 0; i < count; ++i) {
+			auto f = std::clamp(channel[i], 0.0f, 1.0f);
+			image.texels[i * 4 + c] = static_cast<uint16_t>(f * 65535.0f + 0.5f);
+		}
+	}
+
+	return image;
+}
+
+nvtt::Surface Image16::ToSurface() const
+{
+	nvtt::Surface surface;
+	surface.setImage(width, height, 1);
+	surface.setAlphaMode(alpha_mode);
+
+	size_t count = static_cast<size_t>(width) * height;
+	for (int c = 0; c < 4; ++c) {
+		auto channel = surface.channel(c);
+
+		for (size_t i = 0; i < count; ++i)
+			channel[i] = texels[i * 4 + c] / 65535.0f;
+	}
+
+	return surface;
+}
+
+void TargetExtent(int width, int height, long long max_res, int &target_width,
+		  int &target_height)
+{
+	target_width = width;
+	target_height = height;
+
+	auto extent = std::max(width, height);
+	if (max_res <= 0 || extent <= max_res)
+		return;
+
+	target_width = std::max(1, static_cast<int>(int64_t(width) * max_res / extent));
+	target_height = std::max(1, static_cast<int>(int64_t(height) * max_res / extent));
+}
+
+Image16 Resize16(const Image16 &image, int width, int height)
+{
+	return Resample(image, width, height, image.alpha_mode == nvtt::AlphaMode_Transparency);
+}
+
+static void ToPremultipliedLinear(uint16_t *texels, size_t count)
+{
+	auto &tables = Tables();
+
+	for (size_t i = 0; i < count * 4; i += 4) {
+		auto texel = &texels[i];
+		uint32_t alpha = texel[3];
+
+		for (int c = 0; c < 3; ++c)
+			texel[c] = static_cast<uint16_t>((tables.to_linear[texel[c]] * alpha + 32767) /
+							 65535);
+	}
+}
+
+static void FromPremultipliedLinear(uint16_t *texels, size_t count)
+{
+	auto &tables = Tables();
+
+	for (size_t i = 0; i < count * 4; i += 4) {
+		auto texel = &texels[i];
+		uint32_t alpha = texel[3];
+
+		for (int c = 0; c < 3; ++c) {
+			uint32_t value = texel[c];
+			if (alpha > 0)
+				value = std::min<uint32_t>(65535, (value * 65535 + alpha / 2) / alpha);
+
+			texel[c] = tables.to_srgb[value];
+		}
+	}
+}
+
+Image16 NextMipmap16(const Image16 &image)
+{
+	// Filter in premultiplied linear space with alpha-weighted taps for
+	// transparency, as BuildNextMipmap does
+	Image16 linear = image;
+	ToPremultipliedLinear(linear.texels.data(), linear.texels.size() / 4);
+
+	auto next = Resample(linear, std::max(1, image.width / 2), std::max(1, image.height / 2),
+			     image.alpha_mode == nvtt::AlphaMode_Transparency);
+
+	FromPremultipliedLinear(next.texels.data(), next.texels.size() / 4);
+	next.alpha_mode = image.alpha_mode;
+
+	return next;
+}
+
+std::unique_ptr<RowStream> MakeResizeStream(int width, int height, nvtt::AlphaMode alpha_mode,
+					    int target_width, int target_height, RowSink sink)
+{
+	return std::make_unique<ResampleStream>(width, height, target_width, target_height,
+						alpha_mode == nvtt::AlphaMode_Transparency,
+						std::move(sink));
+}
+
+class MipmapStream : public RowStream {
+public:
+	MipmapStream(int width, int height, nvtt::AlphaMode alpha_mode, RowSink sink)
+		: linear(static_cast<size_t>(width) * 4),
+		  next(static_cast<size_t>(std::max(1, width / 2)) * 4),
+		  sink{std::move(sink)},
+		  resample{width,
+			   height,
+			   std::max(1, width / 2),
+			   std::max(1, height / 2),
+			   alpha_mode == nvtt::AlphaMode_Transparency,
+			   [this](const uint16_t *row) { return Emit(row); }}
+	{
+	}
+
+	bool Push(const uint16_t *row) override
+	{
+		std::copy(row, row + linear.size(), linear.begin());
+		ToPremultipliedLinear(linear.data(), linear.size() / 4);
+
+		return resample.Push(linear.data());
+	}
+
+private:
+	std::vector<uint16_t> linear;
+	std::vector<uint16_t> next;
+
+	RowSink sink;
+	ResampleStream resample;
+
+	bool Emit(const uint16_t *row)
+	{
+		std::copy(row, row + next.size(), next.begin());
+		FromPremultipliedLinear(next.data(), next.size() / 4);
+
+		return sink(next.data());
+	}
+};
+
+std::unique_ptr<RowStream> MakeMipmapStream(int width, int height, nvtt::AlphaMode alpha_mode,
+					     RowSink sink)
+{
+	return std::make_unique<MipmapStream>(width, height, alpha_mode, std::move(sink));
+}
+
+std::vector<Image16> BuildMipmapChain16(Image16 image)
+{
+	std::vector<Image16> chain;
+	chain.push_back(std::move(image));
+
+	while (chain.back().CanMakeNextMipmap())
+		chain.push_back(NextMipmap16(chain.back()));
+
+	return chain;
+}
+
+std::optional<SurfaceError> CompareSurfaces(const nvtt::Surface &reference,
+					    const nvtt::Surface &surface)
+{
+	if (reference.width() != surface.width() || reference.height() != surface.height())
+		return std::nullopt;
+
+	size_t count = static_cast<size_t>(reference.width()) * reference.height();
+
+	double squared_error = 0.0;
+	double max_error = 0.0;
+
+	for (int c = 0; c < 4; ++c) {
+		auto a = reference.channel(c);
+		auto b = surface.channel(c);
+
+		for (size_t i = 0; i < count; ++i) {
+			double error = std::fabs(std::clamp(a[i], 0.0f, 1.0f) -
+						 std::clamp(b[i], 0.0f, 1.0f));
+
+			squared_error += error * error;
+			max_error = std::max(max_error, error);
+		}
+	}
+
+	auto mse = squared_error / (count * 4);
+	auto psnr = mse > 0.0 ? 10.0 * std::log10(1.0 / mse)
+			      : std::numeric_limits<double>::infinity();
+
+	return SurfaceError{psnr, max_error};
+}
\ No newline at end of file
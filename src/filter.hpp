@@ -0,0 +1,71 @@
+#pragma once
+
+#include <nvtt/nvtt.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Interleaved RGBA image with unorm16 channels, half the size of the
+// equivalent float nvtt::Surface
+struct Image16 {
+	int width = 0;
+	int height = 0;
+	nvtt::AlphaMode alpha_mode = nvtt::AlphaMode_None;
+
+	std::vector<uint16_t> texels;
+
+	Image16() = default;
+	Image16(int width, int height, nvtt::AlphaMode alpha_mode)
+		: width{width},
+		  height{height},
+		  alpha_mode{alpha_mode},
+		  texels(static_cast<size_t>(width) * height * 4)
+	{
+	}
+
+	static Image16 FromSurface(const nvtt::Surface &surface);
+	nvtt::Surface ToSurface() const;
+
+	bool CanMakeNextMipmap() const { return width > 1 || height > 1; }
+};
+
+// Matches the extent nvtt::Surface::resize picks for RoundMode_None
+void TargetExtent(int width, int height, long long max_res, int &target_width,
+		  int &target_height);
+
+// Separable Kaiser filters equivalent to ResizeFilter_Kaiser and
+// MipmapFilter_Kaiser, accumulating in float and storing unorm16
+Image16 Resize16(const Image16 &image, int width, int height);
+Image16 NextMipmap16(const Image16 &image);
+std::vector<Image16> BuildMipmapChain16(Image16 image);
+
+// Receives one row of unorm16 RGBA texels, returning false aborts the stream
+using RowSink = std::function<bool(const uint16_t *row)>;
+
+// Streaming forms of Resize16 and NextMipmap16 with identical output. Source
+// rows are pushed top to bottom and each output row is passed to the sink as
+// soon as its last filter tap has been pushed, so only a window of rows is
+// ever held.
+class RowStream {
+public:
+	virtual ~RowStream() = default;
+	virtual bool Push(const uint16_t *row) = 0;
+};
+
+std::unique_ptr<RowStream> MakeResizeStream(int width, int height, nvtt::AlphaMode alpha_mode,
+					    int target_width, int target_height, RowSink sink);
+std::unique_ptr<RowStream> MakeMipmapStream(int width, int height, nvtt::AlphaMode alpha_mode,
+					     RowSink sink);
+
+struct SurfaceError {
+	double psnr;
+	double max_error;
+};
+
+// Returns nothing if the surfaces differ in size
+std::optional<SurfaceError> CompareSurfaces(const nvtt::Surface &reference,
+					    const nvtt::Surface &surface);
\ No newline at end of file
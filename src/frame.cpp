@@ -1,6 +1,9 @@
 #include "frame.hpp"
 
+#include <algorithm>
 #include <filesystem>
+#include <format>
+#include <wx/config.h>
 #include <wx/stdpaths.h>
 
 std::filesystem::path GetDocumentsPath()
@@ -91,6 +94,59 @@ MODE GuessMode(const std::filesystem::path &input)
 	return MODE_UNKNOWN;
 }
 
+wxString FormatDuration(double seconds)
+{
+	auto total = static_cast<long>(seconds + 0.5);
+	return wxString::Format("%ld:%02ld", total / 60, total % 60);
+}
+
+void LogPlan(const ExportPlan &plan)
+{
+	auto mib = [](uint64_t bytes) { return bytes / double(1 << 20); };
+
+	for (size_t j = 0; j < plan.jobs.size(); ++j) {
+		auto &job = plan.jobs[j];
+		auto &job_plan = plan.job_plans[j];
+
+		auto text = wxString::Format("Plan for %ls: %zu images, %.1f MiB in, %.1f MiB out",
+					     job.name, job_plan.paths.size(),
+					     mib(job_plan.input_bytes), mib(job_plan.dds_bytes));
+
+		for (size_t i = 0; i < job_plan.paths.size(); ++i) {
+			auto &image = job_plan.images[i];
+			auto filename = job_plan.paths[i].input.filename().wstring();
+
+			text += "\n  " + filename + ": ";
+
+			if (!image.source.has_value()) {
+				text += "unreadable header";
+			} else if (!image.format.has_value()) {
+				text += "unknown format, skipped";
+			} else {
+				text += wxString::Format("%dx%d -> %dx%d %s, %d levels%s, %.2f MiB",
+							 image.source->width, image.source->height,
+							 image.width, image.height,
+							 FormatToString(image.format.value()),
+							 image.levels, image.tiled ? ", tiled" : "",
+							 mib(image.dds_bytes));
+			}
+		}
+
+		for (auto &duplicate : job_plan.duplicates)
+			text += wxString::Format("\n  %ls: duplicate stem, skipped",
+						 duplicate.filename().wstring());
+
+		wxLogMessage("%s", text);
+	}
+
+	wxString time = "no timing for these settings yet, export once to calibrate";
+	if (plan.seconds.has_value())
+		time = "about " + FormatDuration(plan.seconds.value()) + " without cache hits";
+
+	wxLogMessage("Plan: %.1f MiB of DDS, peak memory about %.2f GiB on %d threads, %s",
+		     mib(plan.dds_bytes), plan.peak_memory / double(1 << 30), plan.workers, time);
+}
+
 Frame::Frame(const wxString &title)
 	: wxFrame(NULL, wxID_ANY, title, wxDefaultPosition, wxDefaultSize,
 		  wxDEFAULT_FRAME_STYLE & ~(wxRESIZE_BORDER | wxMAXIMIZE_BOX))
@@ -107,12 +163,61 @@ Frame::Frame(const wxString &title)
 	output_panel = new OutputPanel(top_panel, wxID_ANY);
 	output_panel->Disable();
 
+	// The cache is usually a shared team directory, so remember it
+	auto config = wxConfigBase::Get();
+	cache_dir = config->Read("CacheDir", wxEmptyString).ToStdWstring();
+	cache_size_gib = config->ReadLong("CacheSizeGiB", cache_size_gib);
+
+	output_panel->SetCachePath(cache_dir);
+	output_panel->SetCacheSize(cache_size_gib);
+
+	// Engine settings depend on the machine rather than the export
+	engine_panel = new EnginePanel(top_panel, wxID_ANY);
+
+	engine_options.threads = config->ReadLong("EngineThreads", engine_options.threads);
+	engine_options.priority =
+		static_cast<PRIORITY>(config->ReadLong("EnginePriority", engine_options.priority));
+	engine_options.affinity =
+		static_cast<AFFINITY>(config->ReadLong("EngineAffinity", engine_options.affinity));
+
+	engine_panel->SetOptions(engine_options);
+
+	auto queue_sizer = new wxBoxSizer(wxHORIZONTAL);
+
+	queue_button = new wxButton(top_panel, ID_QUEUE_BUTTON, "Add to queue");
+	queue_button->Disable();
+
+	clear_queue_button = new wxButton(top_panel, ID_CLEAR_QUEUE_BUTTON, "Clear queue");
+	clear_queue_button->Disable();
+
+	queue_sizer->Add(queue_button, wxSizerFlags(1).Expand().Border(wxRIGHT));
+	queue_sizer->Add(clear_queue_button, wxSizerFlags(1).Expand().Border(wxLEFT));
+
+	queue_list = new wxListBox(top_panel, wxID_ANY);
+	queue_list->SetMinSize({0, 64});
+
+	auto export_sizer = new wxBoxSizer(wxHORIZONTAL);
+
+	plan_button = new wxButton(top_panel, ID_PLAN_BUTTON, "Plan");
+	plan_button->Disable();
+
 	export_button = new wxButton(top_panel, ID_EXPORT_BUTTON, "Export");
 	export_button->Disable();
 
+	cancel_button = new wxButton(top_panel, ID_CANCEL_BUTTON, "Cancel");
+	cancel_button->Disable();
+
+	export_sizer->Add(plan_button, wxSizerFlags(1).Expand().Border(wxRIGHT));
+	export_sizer->Add(export_button, wxSizerFlags(1).Expand().Border(wxLEFT | wxRIGHT));
+	export_sizer->Add(cancel_button, wxSizerFlags(1).Expand().Border(wxLEFT));
+
 	progress_bar = new wxGauge(top_panel, wxID_ANY, 0);
 	progress_bar->Disable();
 
+	progress_text = new wxStaticText(top_panel, wxID_ANY, wxEmptyString);
+
+	progress_timer.SetOwner(this, ID_PROGRESS_TIMER);
+
 	log = new wxTextCtrl(top_panel, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize,
 			     wxTE_RICH | wxTE_MULTILINE | wxTE_READONLY);
 	log->SetMinSize({0, 192});
@@ -129,8 +234,12 @@ Frame::Frame(const wxString &title)
 
 	sizer->Add(input_panel, wxSizerFlags().Expand().Border());
 	sizer->Add(output_panel, wxSizerFlags().Expand().Border());
-	sizer->Add(export_button, wxSizerFlags().Expand().Border());
+	sizer->Add(engine_panel, wxSizerFlags().Expand().Border());
+	sizer->Add(queue_sizer, wxSizerFlags().Expand().Border());
+	sizer->Add(queue_list, wxSizerFlags().Expand().Border());
+	sizer->Add(export_sizer, wxSizerFlags().Expand().Border());
 	sizer->Add(progress_bar, wxSizerFlags().Expand().Border());
+	sizer->Add(progress_text, wxSizerFlags().Expand().Border(wxLEFT | wxRIGHT));
 	sizer->Add(log, wxSizerFlags().Expand().Border());
 
 	sizer->Fit(top_panel);
@@ -141,8 +250,10 @@ void Frame::OnInputChange(wxFileDirPickerEvent &event)
 {
 	input_dir = event.GetPath().ToStdWstring();
 	if (!std::filesystem::exists(input_dir.value())) {
+		input_dir.reset();
+
 		output_panel->Disable();
-		export_button->Disable();
+		UpdateExportButtons();
 
 		return;
 	}
@@ -168,7 +279,7 @@ void Frame::OnInputChange(wxFileDirPickerEvent &event)
 	output_panel->SetMode(mode);
 	output_panel->SetBuildMipmaps(build_mipmaps);
 
-	export_button->Enable(output_dir != "");
+	UpdateExportButtons();
 
 	wxLogMessage("Guessed mode: %s",
 		     mode == MODE_SKIN ? "skin" : (mode == MODE_MOD ? "mod" : "unknown"));
@@ -177,7 +288,7 @@ void Frame::OnInputChange(wxFileDirPickerEvent &event)
 void Frame::OnOuputChange(wxFileDirPickerEvent &event)
 {
 	output_dir = event.GetPath().ToStdWstring();
-	export_button->Enable(output_dir != "");
+	UpdateExportButtons();
 }
 
 void Frame::OnNameChange(wxCommandEvent &event)
@@ -208,8 +319,8 @@ void Frame::OnModeChoice(wxCommandEvent &event)
 	output_panel->SetFormat(format);
 	output_panel->SetPath(output_dir.value());
 	output_panel->SetBuildMipmaps(build_mipmaps);
-	
-	export_button->Enable(output_dir != "");
+
+	UpdateExportButtons();
 }
 
 void Frame::OnMaxResChoice(wxCommandEvent &event)
@@ -219,8 +330,7 @@ void Frame::OnMaxResChoice(wxCommandEvent &event)
 
 void Frame::OnQualityChoice(wxCommandEvent &event)
 {
-	void *quality_ptr = event.GetClientData();
-	quality = *reinterpret_cast<nvtt::Quality *>(&quality_ptr);
+	quality = static_cast<QUALITY>(reinterpret_cast<long long>(event.GetClientData()));
 }
 
 void Frame::OnBuildMipmapsChoice(wxCommandEvent &event)
@@ -229,45 +339,247 @@ void Frame::OnBuildMipmapsChoice(wxCommandEvent &event)
 	build_mipmaps = *reinterpret_cast<bool *>(&build_mimaps_ptr);
 }
 
+ExportJob Frame::CurrentJob() const
+{
+	ExportJob job;
+
+	job.input_dir = input_dir.value();
+	job.output_dir = output_dir.value();
+	job.name = name;
+	job.format = format;
+	job.max_res = max_res;
+	job.quality = quality;
+	job.build_mipmaps = build_mipmaps;
+	job.working_format = working_format;
+
+	return job;
+}
+
+std::vector<ExportJob> Frame::PendingJobs() const
+{
+	return queue.empty() ? std::vector<ExportJob>{CurrentJob()} : queue;
+}
+
+void Frame::UpdateExportButtons()
+{
+	auto can_queue = input_dir.has_value() && output_dir.has_value() && output_dir != "";
+
+	queue_button->Enable(can_queue);
+	clear_queue_button->Enable(!queue.empty());
+	plan_button->Enable(can_queue || !queue.empty());
+	export_button->Enable(can_queue || !queue.empty());
+}
+
+void Frame::OnQueuePressed(wxCommandEvent &event)
+{
+	queue.push_back(CurrentJob());
+	queue_list->Append(std::format(L"{} -> {} ({})", input_dir->wstring(),
+				       output_dir->wstring(), name));
+
+	UpdateExportButtons();
+}
+
+void Frame::OnClearQueuePressed(wxCommandEvent &event)
+{
+	queue.clear();
+	queue_list->Clear();
+
+	UpdateExportButtons();
+}
+
+void Frame::OnWorkingFormatChoice(wxCommandEvent &event)
+{
+	working_format =
+		static_cast<WORKING_FORMAT>(reinterpret_cast<long long>(event.GetClientData()));
+}
+
+void Frame::OnCacheChange(wxFileDirPickerEvent &event)
+{
+	cache_dir = event.GetPath().ToStdWstring();
+	wxConfigBase::Get()->Write("CacheDir", wxString(cache_dir.wstring()));
+}
+
+void Frame::OnCacheSizeChoice(wxCommandEvent &event)
+{
+	cache_size_gib = reinterpret_cast<long long>(event.GetClientData());
+	wxConfigBase::Get()->Write("CacheSizeGiB", static_cast<long>(cache_size_gib));
+}
+
+void Frame::OnThreadsChoice(wxCommandEvent &event)
+{
+	engine_options.threads = reinterpret_cast<long long>(event.GetClientData());
+	wxConfigBase::Get()->Write("EngineThreads", static_cast<long>(engine_options.threads));
+}
+
+void Frame::OnPriorityChoice(wxCommandEvent &event)
+{
+	engine_options.priority =
+		static_cast<PRIORITY>(reinterpret_cast<long long>(event.GetClientData()));
+	wxConfigBase::Get()->Write("EnginePriority", static_cast<long>(engine_options.priority));
+}
+
+void Frame::OnAffinityChoice(wxCommandEvent &event)
+{
+	engine_options.affinity =
+		static_cast<AFFINITY>(reinterpret_cast<long long>(event.GetClientData()));
+	wxConfigBase::Get()->Write("EngineAffinity", static_cast<long>(engine_options.affinity));
+}
+
+void Frame::OnPlanPressed(wxCommandEvent &event)
+{
+	wxBusyCursor busy;
+
+	auto jobs = PendingJobs();
+	auto workers = WorkerCount(engine_options);
+
+	Calibration calibration;
+	for (auto &job : jobs) {
+		auto key = CalibrationKey(job, workers);
+
+		double rate;
+		if (wxConfigBase::Get()->Read("Calibration/" + key, &rate))
+			calibration[key] = rate;
+	}
+
+	plan = PlanExport(jobs, workers, incremental_cache.MaxBytes(), calibration);
+	LogPlan(plan.value());
+}
+
 void Frame::OnExportPressed(wxCommandEvent &event)
 {
 	input_panel->Disable();
 	output_panel->Disable();
+	engine_panel->Disable();
+	queue_button->Disable();
+	clear_queue_button->Disable();
+	plan_button->Disable();
 	export_button->Disable();
+	cancel_button->Enable();
 
 	progress_bar->Enable();
+	progress_bar->SetValue(0);
+	progress_text->SetLabel(wxEmptyString);
+
+	auto jobs = PendingJobs();
+
+	// A plan of other jobs or settings would be of no use to the thread
+	std::optional<ExportPlan> export_plan;
+	if (plan.has_value() && plan->jobs == jobs)
+		export_plan = std::move(plan);
+
+	plan.reset();
 
-	export_thread = new ExportThread(this, input_dir.value(), output_dir.value(), name, format,
-					 max_res, quality, build_mipmaps);
+	queue.clear();
+	queue_list->Clear();
+
+	CacheOptions cache_options;
+	cache_options.dir = cache_dir;
+	cache_options.max_bytes = static_cast<uint64_t>(cache_size_gib) << 30;
+	cache_options.checkpoint_dir =
+		std::filesystem::path{wxStandardPaths::Get().GetUserLocalDataDir().ToStdWstring()} /
+		"checkpoints";
+
+	export_thread = new ExportThread(this, std::move(jobs), &incremental_cache, cache_options,
+					 engine_options, std::move(export_plan));
 	export_thread->Run();
+
+	export_start = std::chrono::steady_clock::now();
+	progress_timer.Start(100);
 }
 
 void Frame::OnExportFinished(wxCommandEvent &event)
 {
+	progress_timer.Stop();
+	DrainExportChannel();
+
+	cancel_button->Disable();
+
 	progress_bar->Disable();
 	progress_bar->SetValue(-1);
 
 	input_panel->Enable();
 	output_panel->Enable();
-	export_button->Enable();
+	engine_panel->Enable();
+	UpdateExportButtons();
 
 	export_thread->Wait();
+
+	if (auto sample = export_thread->Sample()) {
+		auto config = wxConfigBase::Get();
+		auto path = "Calibration/" + sample->key;
+
+		// Averaged with earlier exports so one unusual run does not throw
+		// the next predictions off
+		auto rate = sample->rate;
+		double previous;
+		if (config->Read(path, &previous) && previous > 0)
+			rate = (previous + rate) / 2;
+
+		config->Write(path, rate);
+	}
+
 	delete export_thread;
 }
 
-void Frame::OnExportProgress(wxCommandEvent &event)
+void Frame::OnCancelPressed(wxCommandEvent &event)
 {
-	progress_bar->SetValue(progress_bar->GetValue() + 1);
+	cancel_button->Disable();
+
+	wxLogMessage("Cancelling export...");
+	export_thread->Channel().Cancel();
 }
 
-void Frame::OnExportProgressRange(wxCommandEvent &event)
+void Frame::DrainExportChannel()
 {
-	progress_bar->SetRange(event.GetInt());
+	auto &channel = export_thread->Channel();
+
+	// One append per tick however many workers logged; a wxLogTextCtrl
+	// append per message stalls the UI on exports of thousands of images
+	wxString text;
+	for (auto &record : channel.Drain()) {
+		text += wxDateTime(record.time).Format(wxLog::GetTimestamp()) + ": ";
+
+		if (record.level == wxLOG_Warning)
+			text += "Warning: ";
+		else if (record.level == wxLOG_Error)
+			text += "Error: ";
+
+		text += record.text + "\n";
+	}
+
+	if (!text.empty())
+		log->AppendText(text);
+
+	auto progress = channel.Snapshot();
+	if (progress.items_total == 0)
+		return;
+
+	progress_bar->SetRange(static_cast<int>(progress.items_total));
+	progress_bar->SetValue(static_cast<int>(progress.items));
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - export_start;
+	auto seconds = elapsed.count();
+
+	auto mib = [](uint64_t bytes) { return bytes / double(1 << 20); };
+	auto rate = mib(progress.bytes) / std::max(seconds, 1e-3);
+
+	auto label = wxString::Format("%llu/%llu images, %.0f/%.0f MiB, %.1f MiB/s",
+				      progress.items, progress.items_total, mib(progress.bytes),
+				      mib(progress.bytes_total), rate);
+
+	// Estimated from input bytes, as image sizes vary far more than counts
+	double done = progress.bytes_total > 0 ? double(progress.bytes) / progress.bytes_total
+					       : double(progress.items) / progress.items_total;
+
+	if (done > 0 && done < 1)
+		label += ", ETA " + FormatDuration(seconds * (1 - done) / done);
+
+	progress_text->SetLabel(label);
 }
 
-void Frame::OnExportProgressReset(wxCommandEvent &event)
+void Frame::OnProgressTimer(wxTimerEvent &event)
 {
-	progress_bar->SetValue(0);
+	DrainExportChannel();
 }
 
 /* clang-format off */
@@ -280,11 +592,19 @@ wxBEGIN_EVENT_TABLE(Frame, wxFrame)
 	EVT_CHOICE(ID_MAX_RES_CHOICE, Frame::OnMaxResChoice)
 	EVT_CHOICE(ID_QUALITY_CHOICE, Frame::OnQualityChoice)
 	EVT_CHOICE(ID_BUILD_MIPMAPS_CHOICE, Frame::OnBuildMipmapsChoice)
+	EVT_CHOICE(ID_WORKING_FORMAT_CHOICE, Frame::OnWorkingFormatChoice)
+	EVT_DIRPICKER_CHANGED(ID_CACHE_PICKER, Frame::OnCacheChange)
+	EVT_CHOICE(ID_CACHE_SIZE_CHOICE, Frame::OnCacheSizeChoice)
+	EVT_CHOICE(ID_THREADS_CHOICE, Frame::OnThreadsChoice)
+	EVT_CHOICE(ID_PRIORITY_CHOICE, Frame::OnPriorityChoice)
+	EVT_CHOICE(ID_AFFINITY_CHOICE, Frame::OnAffinityChoice)
+	EVT_BUTTON(ID_QUEUE_BUTTON, Frame::OnQueuePressed)
+	EVT_BUTTON(ID_CLEAR_QUEUE_BUTTON, Frame::OnClearQueuePressed)
+	EVT_BUTTON(ID_PLAN_BUTTON, Frame::OnPlanPressed)
 	EVT_BUTTON(ID_EXPORT_BUTTON, Frame::OnExportPressed)
+	EVT_BUTTON(ID_CANCEL_BUTTON, Frame::OnCancelPressed)
 	
 	EVT_COMMAND(wxID_ANY, EVT_EXPORT_FINISHED, Frame::OnExportFinished)
-	EVT_COMMAND(wxID_ANY, EVT_EXPORT_PROGRESS, Frame::OnExportProgress)
-	EVT_COMMAND(wxID_ANY, EVT_EXPORT_PROGRESS_RANGE, Frame::OnExportProgressRange)
-	EVT_COMMAND(wxID_ANY, EVT_EXPORT_PROGRESS_RESET, Frame::OnExportProgressReset)
+	EVT_TIMER(ID_PROGRESS_TIMER, Frame::OnProgressTimer)
 wxEND_EVENT_TABLE();
 /* clang-format on */
\ No newline at end of file
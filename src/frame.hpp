@@ -3,13 +3,17 @@
 #include "common.hpp"
 #include "input_panel.hpp"
 #include "output_panel.hpp"
+#include "engine_panel.hpp"
 #include "export_thread.hpp"
+#include "planner.hpp"
 #include "nvtt/nvtt.h"
 
 #include <wx/wx.h>
 
+#include <chrono>
 #include <optional>
 #include <filesystem>
+#include <vector>
 
 class Frame : public wxFrame {
 public:
@@ -20,11 +24,22 @@ private:
 
 	InputPanel *input_panel;
 	OutputPanel *output_panel;
+	EnginePanel *engine_panel;
 
+	wxButton *queue_button;
+	wxButton *clear_queue_button;
+	wxListBox *queue_list;
+
+	wxButton *plan_button;
 	wxButton *export_button;
+	wxButton *cancel_button;
 	ExportThread *export_thread;
+	IncrementalCache incremental_cache;
 
 	wxGauge *progress_bar;
+	wxStaticText *progress_text;
+	wxTimer progress_timer;
+	std::chrono::steady_clock::time_point export_start;
 
 	wxTextCtrl *log;
 	std::optional<wxLogTextCtrl> log_target;
@@ -39,9 +54,24 @@ private:
 
 	long long max_res = 4096;
 
-	nvtt::Quality quality = nvtt::Quality_Normal;
+	QUALITY quality = QUALITY_NORMAL;
 	bool build_mipmaps = false;
 
+	WORKING_FORMAT working_format = WORKING_FORMAT_FLOAT;
+
+	std::filesystem::path cache_dir;
+	long long cache_size_gib = 16;
+
+	EngineOptions engine_options;
+
+	std::vector<ExportJob> queue;
+	std::optional<ExportPlan> plan;
+
+	ExportJob CurrentJob() const;
+	std::vector<ExportJob> PendingJobs() const;
+	void UpdateExportButtons();
+	void DrainExportChannel();
+
 	void OnInputChange(wxFileDirPickerEvent &event);
 	void OnOuputChange(wxFileDirPickerEvent &event);
 	void OnNameChange(wxCommandEvent &event);
@@ -50,12 +80,20 @@ private:
 	void OnMaxResChoice(wxCommandEvent &event);
 	void OnQualityChoice(wxCommandEvent &event);
 	void OnBuildMipmapsChoice(wxCommandEvent &event);
+	void OnWorkingFormatChoice(wxCommandEvent &event);
+	void OnCacheChange(wxFileDirPickerEvent &event);
+	void OnCacheSizeChoice(wxCommandEvent &event);
+	void OnThreadsChoice(wxCommandEvent &event);
+	void OnPriorityChoice(wxCommandEvent &event);
+	void OnAffinityChoice(wxCommandEvent &event);
+	void OnQueuePressed(wxCommandEvent &event);
+	void OnClearQueuePressed(wxCommandEvent &event);
+	void OnPlanPressed(wxCommandEvent &event);
 	void OnExportPressed(wxCommandEvent &event);
+	void OnCancelPressed(wxCommandEvent &event);
 
 	void OnExportFinished(wxCommandEvent &event);
-	void OnExportProgress(wxCommandEvent &event);
-	void OnExportProgressRange(wxCommandEvent &event);
-	void OnExportProgressReset(wxCommandEvent &event);
+	void OnProgressTimer(wxTimerEvent &event);
 
 	wxDECLARE_EVENT_TABLE();
 };
\ No newline at end of file
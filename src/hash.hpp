@@ -0,0 +1,29 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+class Sha256 {
+public:
+	Sha256();
+
+	void Update(const void *data, size_t size);
+	void Update(const std::string &data) { Update(data.data(), data.size()); }
+
+	// Returns false if the file could not be read
+	bool UpdateFile(const std::filesystem::path &path);
+
+	std::string HexDigest();
+
+private:
+	std::array<uint32_t, 8> state;
+	std::array<uint8_t, 64> block;
+
+	size_t block_size = 0;
+	uint64_t total_size = 0;
+
+	void Transform(const uint8_t *data);
+};
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "image_reader.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// libpng and libjpeg as built by wxWidgets
+#include <png.h>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+static std::FILE *OpenFile(const std::filesystem::path &input)
+{
+#ifdef _WIN32
+	return _wfopen(input.c_str(), L"rb");
+#else
+	return std::fopen(input.c_str(), "rb");
+#endif
+}
+
+// Both libraries report errors by longjmp back into the function that made
+// the failing call, so those functions keep no objects with destructors
+static void PngError(png_structp png, png_const_charp)
+{
+	std::longjmp(png_jmpbuf(png), 1);
+}
+
+static void PngWarning(png_structp, png_const_charp) {}
+
+class PngReader : public RowReader {
+public:
+	~PngReader()
+	{
+		if (png)
+			png_destroy_read_struct(&png, info ? &info : nullptr, nullptr);
+
+		if (file)
+			std::fclose(file);
+	}
+
+	bool streamable = false;
+
+	// With header_only, stops after the header and succeeds even if the file
+	// cannot be streamed
+	bool Open(const std::filesystem::path &input, bool header_only = false)
+	{
+		file = OpenFile(input);
+		if (!file)
+			return false;
+
+		png_byte signature[8];
+		if (std::fread(signature, 1, sizeof(signature), file) != sizeof(signature) ||
+		    png_sig_cmp(signature, 0, sizeof(signature)) != 0)
+			return false;
+
+		png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, PngError, PngWarning);
+		if (!png)
+			return false;
+
+		info = png_create_info_struct(png);
+		if (!info)
+			return false;
+
+		if (setjmp(png_jmpbuf(png)))
+			return false;
+
+		png_init_io(png, file);
+		png_set_sig_bytes(png, sizeof(signature));
+		png_read_info(png, info);
+
+		width = png_get_image_width(png, info);
+		height = png_get_image_height(png, info);
+
+		has_alpha = (png_get_color_type(png, info) & PNG_COLOR_MASK_ALPHA) ||
+			    png_get_valid(png, info, PNG_INFO_tRNS);
+
+		// Adam7 rows are only complete after the last pass
+		streamable = png_get_interlace_type(png, info) == PNG_INTERLACE_NONE;
+		if (header_only || !streamable)
+			return header_only;
+
+		sixteen_bit = png_get_bit_depth(png, info) == 16;
+
+		png_set_expand(png);
+		png_set_gray_to_rgb(png);
+		png_set_filler(png, sixteen_bit ? 0xffff : 0xff, PNG_FILLER_AFTER);
+
+		if (sixteen_bit)
+			png_set_swap(png);
+
+		png_read_update_info(png, info);
+
+		auto row_bytes = png_get_rowbytes(png, info);
+		if (row_bytes != static_cast<size_t>(width) * (sixteen_bit ? 8 : 4))
+			return false;
+
+		row.resize(row_bytes);
+
+		return true;
+	}
+
+	bool ReadRow(uint16_t *rgba) override
+	{
+		if (setjmp(png_jmpbuf(png)))
+			return false;
+
+		png_read_row(png, row.data(), nullptr);
+
+		if (sixteen_bit) {
+			std::memcpy(rgba, row.data(), row.size());
+		} else {
+			for (size_t i = 0; i < row.size(); ++i)
+				rgba[i] = row[i] * 257;
+		}
+
+		return true;
+	}
+
+private:
+	std::FILE *file = nullptr;
+	png_structp png = nullptr;
+	png_infop info = nullptr;
+
+	bool sixteen_bit = false;
+	std::vector<uint8_t> row;
+};
+
+struct JpegError {
+	jpeg_error_mgr manager;
+	std::jmp_buf jump;
+};
+
+static void JpegErrorExit(j_common_ptr cinfo)
+{
+	std::longjmp(reinterpret_cast<JpegError *>(cinfo->err)->jump, 1);
+}
+
+static void JpegOutputMessage(j_common_ptr) {}
+
+class JpegReader : public RowReader {
+public:
+	~JpegReader()
+	{
+		if (created)
+			jpeg_destroy_decompress(&cinfo);
+
+		if (file)
+			std::fclose(file);
+	}
+
+	bool streamable = false;
+
+	bool Open(const std::filesystem::path &input, bool header_only = false)
+	{
+		file = OpenFile(input);
+		if (!file)
+			return false;
+
+		cinfo.err = jpeg_std_error(&error.manager);
+		error.manager.error_exit = JpegErrorExit;
+		error.manager.output_message = JpegOutputMessage;
+
+		if (setjmp(error.jump))
+			return false;
+
+		jpeg_create_decompress(&cinfo);
+		created = true;
+
+		jpeg_stdio_src(&cinfo, file);
+		jpeg_read_header(&cinfo, TRUE);
+
+		width = cinfo.image_width;
+		height = cinfo.image_height;
+
+		// Progressive scans are buffered as coefficients for the whole image
+		auto color_space = cinfo.jpeg_color_space;
+		streamable = color_space != JCS_CMYK && color_space != JCS_YCCK &&
+			     !cinfo.progressive_mode;
+		if (header_only || !streamable)
+			return header_only;
+
+		cinfo.out_color_space = JCS_RGB;
+		jpeg_start_decompress(&cinfo);
+
+		width = cinfo.output_width;
+		height = cinfo.output_height;
+
+		row.resize(static_cast<size_t>(width) * 3);
+
+		return true;
+	}
+
+	bool ReadRow(uint16_t *rgba) override
+	{
+		if (setjmp(error.jump))
+			return false;
+
+		JSAMPROW rows[] = {row.data()};
+		if (jpeg_read_scanlines(&cinfo, rows, 1) != 1)
+			return false;
+
+		for (int x = 0; x < width; ++x) {
+			for (int c = 0; c < 3; ++c)
+				rgba[x * 4 + c] = row[x * 3 + c] * 257;
+
+			rgba[x * 4 + 3] = 65535;
+		}
+
+		return true;
+	}
+
+private:
+	std::FILE *file = nullptr;
+
+	jpeg_decompress_struct cinfo{};
+	JpegError error{};
+	bool created = false;
+
+	std::vector<JSAMPLE> row;
+};
+
+static std::string LowerExtension(const std::filesystem::path &input)
+{
+	auto extension = input.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+		       [](char c) { return std::tolower(c); });
+
+	return extension;
+}
+
+std::unique_ptr<RowReader> OpenRowReader(const std::filesystem::path &input)
+{
+	auto extension = LowerExtension(input);
+
+	if (extension == ".png") {
+		auto reader = std::make_unique<PngReader>();
+		if (reader->Open(input))
+			return reader;
+	} else if (extension == ".jpg" || extension == ".jpeg") {
+		auto reader = std::make_unique<JpegReader>();
+		if (reader->Open(input))
+			return reader;
+	}
+
+	return nullptr;
+}
+
+template <typename Reader>
+static std::optional<ImageInfo> ReadInfo(const std::filesystem::path &input)
+{
+	Reader reader;
+	if (!reader.Open(input, true))
+		return std::nullopt;
+
+	return ImageInfo{reader.width, reader.height, reader.has_alpha, reader.streamable};
+}
+
+std::optional<ImageInfo> ReadImageInfo(const std::filesystem::path &input)
+{
+	auto extension = LowerExtension(input);
+
+	if (extension == ".png")
+		return ReadInfo<PngReader>(input);
+	else if (extension == ".jpg" || extension == ".jpeg")
+		return ReadInfo<JpegReader>(input);
+
+	return std::nullopt;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+// Decodes an image one row at a time into interleaved unorm16 RGBA, for
+// sources too large to decode whole
+class RowReader {
+public:
+	int width = 0;
+	int height = 0;
+	bool has_alpha = false;
+
+	virtual ~RowReader() = default;
+	virtual bool ReadRow(uint16_t *rgba) = 0;
+};
+
+struct ImageInfo {
+	int width;
+	int height;
+	bool has_alpha;
+
+	// False for files OpenRowReader cannot open
+	bool streamable;
+};
+
+// Reads only the header. Returns nothing for files that cannot be streamed,
+// which includes interlaced PNGs and progressive or CMYK JPEGs.
+std::unique_ptr<RowReader> OpenRowReader(const std::filesystem::path &input);
+
+// Reads only the header, of any PNG or JPEG
+std::optional<ImageInfo> ReadImageInfo(const std::filesystem::path &input);
\ No newline at end of file
@@ -0,0 +1,348 @@
+#include "incremental.hpp"
+#include "texture.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// The Kaiser mipmap kernel reads up to 6 texels of the previous level either
+// side of a texel; crops are padded past that so their edges never matter
+static constexpr int mip_reach = 6;
+static constexpr int mip_margin = 8;
+
+struct BlockRect {
+	int x0, y0, x1, y1;
+};
+
+struct DirtyMap {
+	int width;
+	int height;
+	std::vector<uint8_t> blocks;
+
+	DirtyMap(int width, int height)
+		: width{width}, height{height}, blocks(static_cast<size_t>(width) * height)
+	{
+	}
+
+	bool Get(int x, int y) const { return blocks[static_cast<size_t>(y) * width + x]; }
+	void Set(int x, int y) { blocks[static_cast<size_t>(y) * width + x] = 1; }
+};
+
+static DirtyMap DiffImages(const Image16 &prev, const Image16 &next)
+{
+	auto width = next.width;
+	auto height = next.height;
+
+	DirtyMap dirty{BlocksFor(width), BlocksFor(height)};
+
+	for (int y = 0; y < height; ++y) {
+		auto prev_row = &prev.texels[static_cast<size_t>(y) * width * 4];
+		auto next_row = &next.texels[static_cast<size_t>(y) * width * 4];
+
+		if (std::memcmp(prev_row, next_row, width * 4 * sizeof(uint16_t)) == 0)
+			continue;
+
+		for (int bx = 0; bx < dirty.width; ++bx) {
+			if (dirty.Get(bx, y / 4))
+				continue;
+
+			auto x0 = bx * 4;
+			auto n = std::min(4, width - x0);
+
+			if (std::memcmp(&prev_row[x0 * 4], &next_row[x0 * 4],
+					n * 4 * sizeof(uint16_t)) != 0)
+				dirty.Set(bx, y / 4);
+		}
+	}
+
+	return dirty;
+}
+
+static DirtyMap PropagateDirty(const DirtyMap &dirty, int src_width, int src_height,
+			       int dst_width, int dst_height)
+{
+	DirtyMap next{BlocksFor(dst_width), BlocksFor(dst_height)};
+
+	// Odd levels are not an exact 2:1 reduction, so nothing local can be said
+	if (src_width % 2 != 0 || src_height % 2 != 0) {
+		std::fill(next.blocks.begin(), next.blocks.end(), 1);
+		return next;
+	}
+
+	auto to_dst = [](int src_lo, int src_hi, int src_len, int dst_blocks) {
+		auto lo = std::max(0, src_lo - mip_reach) / 2 / 4;
+		auto hi = (std::min(src_len, src_hi + mip_reach) / 2 + 3) / 4;
+
+		return std::pair{lo, std::min(hi, dst_blocks)};
+	};
+
+	for (int by = 0; by < dirty.height; ++by) {
+		for (int bx = 0; bx < dirty.width; ++bx) {
+			if (!dirty.Get(bx, by))
+				continue;
+
+			auto [x0, x1] = to_dst(bx * 4, bx * 4 + 4, src_width, next.width);
+			auto [y0, y1] = to_dst(by * 4, by * 4 + 4, src_height, next.height);
+
+			for (int y = y0; y < y1; ++y)
+				for (int x = x0; x < x1; ++x)
+					next.Set(x, y);
+		}
+	}
+
+	return next;
+}
+
+// Groups runs of dirty block rows into their bounding rectangles
+static std::vector<BlockRect> DirtyRects(const DirtyMap &dirty)
+{
+	std::vector<BlockRect> rects;
+	std::optional<BlockRect> current;
+
+	for (int by = 0; by < dirty.height; ++by) {
+		int x0 = dirty.width;
+		int x1 = 0;
+
+		for (int bx = 0; bx < dirty.width; ++bx) {
+			if (dirty.Get(bx, by)) {
+				x0 = std::min(x0, bx);
+				x1 = bx + 1;
+			}
+		}
+
+		if (x0 >= x1) {
+			if (current.has_value())
+				rects.push_back(current.value());
+
+			current.reset();
+			continue;
+		}
+
+		if (current.has_value()) {
+			current->x0 = std::min(current->x0, x0);
+			current->x1 = std::max(current->x1, x1);
+			current->y1 = by + 1;
+		} else {
+			current = BlockRect{x0, by, x1, by + 1};
+		}
+	}
+
+	if (current.has_value())
+		rects.push_back(current.value());
+
+	return rects;
+}
+
+// Float copy of the texels in [x0, x1) x [y0, y1)
+static nvtt::Surface CropSurface(const Image16 &image, int x0, int y0, int x1, int y1)
+{
+	nvtt::Surface surface;
+	surface.setImage(x1 - x0, y1 - y0, 1);
+	surface.setAlphaMode(image.alpha_mode);
+
+	for (int c = 0; c < 4; ++c) {
+		auto channel = surface.channel(c);
+
+		for (int y = y0; y < y1; ++y) {
+			auto row = &image.texels[static_cast<size_t>(y) * image.width * 4];
+			auto out = &channel[static_cast<size_t>(y - y0) * (x1 - x0)];
+
+			for (int x = x0; x < x1; ++x)
+				out[x - x0] = row[x * 4 + c] / 65535.0f;
+		}
+	}
+
+	return surface;
+}
+
+static void RebuildMipmapRect(const Image16 &prev_level, Image16 &level, const BlockRect &rect)
+{
+	auto x0 = rect.x0 * 4;
+	auto y0 = rect.y0 * 4;
+	auto x1 = std::min(rect.x1 * 4, level.width);
+	auto y1 = std::min(rect.y1 * 4, level.height);
+
+	auto src_x0 = std::max(0, 2 * x0 - mip_margin);
+	auto src_y0 = std::max(0, 2 * y0 - mip_margin);
+	auto src_x1 = std::min(prev_level.width, 2 * x1 + mip_margin);
+	auto src_y1 = std::min(prev_level.height, 2 * y1 + mip_margin);
+
+	auto crop = CropSurface(prev_level, src_x0, src_y0, src_x1, src_y1);
+	BuildNextMipmap(crop);
+
+	for (int c = 0; c < 4; ++c) {
+		auto channel = crop.channel(c);
+
+		for (int y = y0; y < y1; ++y) {
+			auto in = &channel[static_cast<size_t>(y - src_y0 / 2) * crop.width()];
+			auto row = &level.texels[static_cast<size_t>(y) * level.width * 4];
+
+			for (int x = x0; x < x1; ++x) {
+				auto f = std::clamp(in[x - src_x0 / 2], 0.0f, 1.0f);
+				row[x * 4 + c] = static_cast<uint16_t>(f * 65535.0f + 0.5f);
+			}
+		}
+	}
+}
+
+static bool EncodeRect(const Image16 &level, const BlockRect &rect, const BlockEncoder &encode,
+		       int block_size, uint8_t *level_data)
+{
+	auto x0 = rect.x0 * 4;
+	auto y0 = rect.y0 * 4;
+	auto x1 = std::min(rect.x1 * 4, level.width);
+	auto y1 = std::min(rect.y1 * 4, level.height);
+
+	auto crop = CropSurface(level, x0, y0, x1, y1);
+
+	std::vector<uint8_t> blocks;
+	if (!encode(crop, blocks))
+		return false;
+
+	size_t row_bytes = static_cast<size_t>(rect.x1 - rect.x0) * block_size;
+	if (blocks.size() != row_bytes * (rect.y1 - rect.y0))
+		return false;
+
+	size_t level_row_bytes = static_cast<size_t>(BlocksFor(level.width)) * block_size;
+	for (int row = 0; row < rect.y1 - rect.y0; ++row) {
+		std::memcpy(&level_data[(rect.y0 + row) * level_row_bytes + rect.x0 * block_size],
+			    &blocks[row * row_bytes], row_bytes);
+	}
+
+	return true;
+}
+
+IncrementalEntry::IncrementalEntry(nvtt::Format format, long long max_res, QUALITY quality,
+				   bool build_mipmaps, const std::vector<nvtt::Surface> &chain,
+				   std::vector<uint8_t> dds)
+	: format{format},
+	  max_res{max_res},
+	  quality{quality},
+	  build_mipmaps{build_mipmaps},
+	  dds{std::move(dds)}
+{
+	for (auto &level : chain)
+		this->chain.push_back(Image16::FromSurface(level));
+}
+
+bool IncrementalEntry::Matches(nvtt::Format format, long long max_res, QUALITY quality,
+			       bool build_mipmaps) const
+{
+	return this->format == format && this->max_res == max_res && this->quality == quality &&
+	       this->build_mipmaps == build_mipmaps;
+}
+
+size_t IncrementalEntry::BytesFor(const std::vector<nvtt::Surface> &chain, size_t dds_bytes)
+{
+	size_t bytes = dds_bytes;
+	for (auto &level : chain)
+		bytes += static_cast<size_t>(level.width()) * level.height() * 4 * sizeof(uint16_t);
+
+	return bytes;
+}
+
+size_t IncrementalEntry::Bytes() const
+{
+	size_t bytes = dds.size();
+	for (auto &level : chain)
+		bytes += level.texels.size() * sizeof(uint16_t);
+
+	return bytes;
+}
+
+std::optional<size_t> IncrementalEntry::Update(const nvtt::Surface &image,
+					       const BlockEncoder &encode)
+{
+	if (chain.empty() || image.width() != chain.front().width ||
+	    image.height() != chain.front().height)
+		return std::nullopt;
+
+	auto block_size = BlockSize(format);
+
+	size_t levels_size = 0;
+	for (auto &level : chain)
+		levels_size += static_cast<size_t>(BlocksFor(level.width)) *
+			       BlocksFor(level.height) * block_size;
+
+	if (dds.size() < levels_size)
+		return std::nullopt;
+
+	auto base = Image16::FromSurface(image);
+
+	auto dirty = DiffImages(chain.front(), base);
+	chain.front() = std::move(base);
+
+	size_t encoded = 0;
+	size_t level_offset = dds.size() - levels_size;
+
+	for (size_t i = 0; i < chain.size(); ++i) {
+		auto &level = chain[i];
+
+		if (i > 0) {
+			auto &prev_level = chain[i - 1];
+			dirty = PropagateDirty(dirty, prev_level.width, prev_level.height,
+					       level.width, level.height);
+		}
+
+		auto rects = DirtyRects(dirty);
+		if (rects.empty())
+			break;
+
+		for (auto &rect : rects) {
+			if (i > 0)
+				RebuildMipmapRect(chain[i - 1], level, rect);
+
+			if (!EncodeRect(level, rect, encode, block_size, &dds[level_offset]))
+				return std::nullopt;
+
+			encoded += static_cast<size_t>(rect.x1 - rect.x0) * (rect.y1 - rect.y0);
+		}
+
+		level_offset += static_cast<size_t>(BlocksFor(level.width)) *
+				BlocksFor(level.height) * block_size;
+	}
+
+	return encoded;
+}
+
+std::unique_ptr<IncrementalEntry> IncrementalCache::Take(const std::filesystem::path &input)
+{
+	std::lock_guard lock{mutex};
+
+	auto it = slots.find(input);
+	if (it == slots.end())
+		return nullptr;
+
+	auto entry = std::move(it->second.entry);
+	total_bytes -= entry->Bytes();
+	slots.erase(it);
+
+	return entry;
+}
+
+void IncrementalCache::Store(const std::filesystem::path &input,
+			     std::unique_ptr<IncrementalEntry> entry)
+{
+	auto bytes = entry->Bytes();
+	if (!Fits(bytes))
+		return;
+
+	std::lock_guard lock{mutex};
+
+	auto it = slots.find(input);
+	if (it != slots.end()) {
+		total_bytes -= it->second.entry->Bytes();
+		slots.erase(it);
+	}
+
+	while (total_bytes + bytes > max_bytes && !slots.empty()) {
+		auto lru = std::min_element(slots.begin(), slots.end(), [](auto &a, auto &b) {
+			return a.second.last_use < b.second.last_use;
+		});
+
+		total_bytes -= lru->second.entry->Bytes();
+		slots.erase(lru);
+	}
+
+	total_bytes += bytes;
+	slots[input] = Slot{std::move(entry), use_counter++};
+}
\ No newline at end of file
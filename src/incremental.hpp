@@ -0,0 +1,71 @@
+#pragma once
+
+#include "common.hpp"
+#include "filter.hpp"
+#include "texture.hpp"
+
+#include <nvtt/nvtt.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// Decoded mip chain and DDS output of a previous export, used to re-encode
+// only the BC blocks touched by an edit. The chain is kept in unorm16, half
+// the size of float and still finer than anything the BC formats store.
+struct IncrementalEntry {
+	nvtt::Format format;
+	long long max_res;
+	QUALITY quality;
+	bool build_mipmaps;
+
+	std::vector<Image16> chain;
+	std::vector<uint8_t> dds;
+
+	IncrementalEntry(nvtt::Format format, long long max_res, QUALITY quality,
+			 bool build_mipmaps, const std::vector<nvtt::Surface> &chain,
+			 std::vector<uint8_t> dds);
+
+	bool Matches(nvtt::Format format, long long max_res, QUALITY quality,
+		     bool build_mipmaps) const;
+	size_t Bytes() const;
+
+	// Bytes of an entry made from chain and a DDS of dds_bytes
+	static size_t BytesFor(const std::vector<nvtt::Surface> &chain, size_t dds_bytes);
+
+	// Returns the number of re-encoded blocks, or nothing if the entry could
+	// not be patched and a full compression is needed
+	std::optional<size_t> Update(const nvtt::Surface &image, const BlockEncoder &encode);
+};
+
+class IncrementalCache {
+public:
+	IncrementalCache(size_t max_bytes = 2ull << 30) : max_bytes{max_bytes} {}
+
+	// Larger entries are not kept, so a single big texture cannot evict
+	// every other one
+	static constexpr size_t min_entries = 8;
+
+	std::unique_ptr<IncrementalEntry> Take(const std::filesystem::path &input);
+	void Store(const std::filesystem::path &input, std::unique_ptr<IncrementalEntry> entry);
+
+	size_t MaxBytes() const { return max_bytes; }
+	bool Fits(size_t bytes) const { return bytes <= max_bytes / min_entries; }
+
+private:
+	struct Slot {
+		std::unique_ptr<IncrementalEntry> entry;
+		uint64_t last_use;
+	};
+
+	std::mutex mutex;
+	std::map<std::filesystem::path, Slot> slots;
+
+	size_t max_bytes;
+	size_t total_bytes = 0;
+	uint64_t use_counter = 0;
+};
\ No newline at end of file
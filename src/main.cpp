@@ -16,7 +16,4 @@ bool ModExporter::OnInit()
 
 wxIMPLEMENT_APP(ModExporter);
 
-wxDEFINE_EVENT(EVT_EXPORT_FINISHED, wxThreadEvent);
-wxDEFINE_EVENT(EVT_EXPORT_PROGRESS, wxThreadEvent);
-wxDEFINE_EVENT(EVT_EXPORT_PROGRESS_RANGE, wxThreadEvent);
-wxDEFINE_EVENT(EVT_EXPORT_PROGRESS_RESET, wxThreadEvent);
\ No newline at end of file
+wxDEFINE_EVENT(EVT_EXPORT_FINISHED, wxThreadEvent);
\ No newline at end of file
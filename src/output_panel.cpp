@@ -50,9 +50,10 @@ OutputPanel::OutputPanel(wxWindow *parent, wxWindowID id) : wxPanel(parent, id)
 	auto quality_choice_label = new wxStaticText(box->GetStaticBox(), wxID_ANY, "Quality");
 	quality_choice = new wxChoice(box->GetStaticBox(), ID_QUALITY_CHOICE);
 
-	quality_choice->Append("Fastest", reinterpret_cast<void *>(nvtt::Quality_Fastest));
-	quality_choice->Append("Normal", reinterpret_cast<void *>(nvtt::Quality_Normal));
-	quality_choice->Append("Highest", reinterpret_cast<void *>(nvtt::Quality_Highest));
+	quality_choice->Append("Fastest", reinterpret_cast<void *>(QUALITY_FASTEST));
+	quality_choice->Append("Normal", reinterpret_cast<void *>(QUALITY_NORMAL));
+	quality_choice->Append("Highest", reinterpret_cast<void *>(QUALITY_HIGHEST));
+	quality_choice->Append("Fast CPU (built-in)", reinterpret_cast<void *>(QUALITY_BUILTIN));
 
 	quality_choice->SetSelection(quality_choice->FindString("Normal"));
 
@@ -67,6 +68,35 @@ OutputPanel::OutputPanel(wxWindow *parent, wxWindowID id) : wxPanel(parent, id)
 
 	build_mipmaps_choice->SetSelection(0);
 
+	// Working format choice
+	auto working_format_choice_label =
+		new wxStaticText(box->GetStaticBox(), wxID_ANY, "Working precision");
+	working_format_choice = new wxChoice(box->GetStaticBox(), ID_WORKING_FORMAT_CHOICE);
+
+	working_format_choice->Append("Float", reinterpret_cast<void *>(WORKING_FORMAT_FLOAT));
+	working_format_choice->Append("16-bit", reinterpret_cast<void *>(WORKING_FORMAT_UNORM16));
+	working_format_choice->Append("16-bit (compare with float)",
+				      reinterpret_cast<void *>(WORKING_FORMAT_COMPARE));
+
+	working_format_choice->SetSelection(0);
+
+	// Compression cache picker and size choice
+	auto cache_picker_label =
+		new wxStaticText(box->GetStaticBox(), wxID_ANY, "Compression cache (optional)");
+	cache_picker = new wxDirPickerCtrl(box->GetStaticBox(), ID_CACHE_PICKER, wxEmptyString,
+					   wxDirSelectorPromptStr, wxDefaultPosition,
+					   wxDefaultSize, wxDIRP_USE_TEXTCTRL);
+
+	cache_size_choice = new wxChoice(box->GetStaticBox(), ID_CACHE_SIZE_CHOICE);
+	for (long long i = 1; i <= 64; i *= 4)
+		cache_size_choice->Append(std::format("{} GiB", i), reinterpret_cast<void *>(i));
+
+	cache_size_choice->SetSelection(cache_size_choice->FindString("16 GiB"));
+
+	auto cache_sizer = new wxBoxSizer(wxHORIZONTAL);
+	cache_sizer->Add(cache_picker, wxSizerFlags(1).Expand().Border(wxRIGHT));
+	cache_sizer->Add(cache_size_choice, wxSizerFlags().Expand().Border(wxLEFT));
+
 	// Sizing
 	sizer->Add(name_text_label, wxSizerFlags().Border(wxRIGHT | wxTOP | wxBOTTOM));
 	sizer->Add(format_choice_label, wxSizerFlags().Border(wxLEFT | wxTOP | wxBOTTOM));
@@ -86,11 +116,19 @@ OutputPanel::OutputPanel(wxWindow *parent, wxWindowID id) : wxPanel(parent, id)
 	sizer->Add(quality_choice, wxSizerFlags().Expand().Border(wxRIGHT | wxBOTTOM));
 	sizer->Add(build_mipmaps_choice, wxSizerFlags().Expand().Border(wxLEFT | wxBOTTOM));
 
+	sizer->Add(working_format_choice_label, wxSizerFlags().Border(wxRIGHT | wxTOP | wxBOTTOM));
+	sizer->AddSpacer(0);
+
+	sizer->Add(working_format_choice, wxSizerFlags().Expand().Border(wxRIGHT | wxBOTTOM));
+	sizer->AddSpacer(0);
+
 	sizer->AddGrowableCol(0);
 	sizer->AddGrowableCol(1);
 
 	box->Add(output_picker, wxSizerFlags().Expand().Border());
 	box->Add(sizer, wxSizerFlags().Expand().Border());
+	box->Add(cache_picker_label, wxSizerFlags().Border(wxLEFT | wxRIGHT | wxTOP));
+	box->Add(cache_sizer, wxSizerFlags().Expand().Border());
 
 	box->GetStaticBox()->SetSizerAndFit(sizer);
 	SetSizerAndFit(box);
@@ -119,4 +157,16 @@ void OutputPanel::SetMode(MODE mode)
 void OutputPanel::SetBuildMipmaps(bool build_mipmaps)
 {
 	build_mipmaps_choice->SetSelection(build_mipmaps);
+}
+
+void OutputPanel::SetCachePath(const std::filesystem::path &path)
+{
+	cache_picker->SetPath(path.c_str());
+}
+
+void OutputPanel::SetCacheSize(long long cache_size_gib)
+{
+	auto selection = cache_size_choice->FindString(std::format("{} GiB", cache_size_gib));
+	if (selection != wxNOT_FOUND)
+		cache_size_choice->SetSelection(selection);
 }
\ No newline at end of file
@@ -18,6 +18,8 @@ public:
 	void SetFormat(FORMAT format);
 	void SetMode(MODE mode);
 	void SetBuildMipmaps(bool build_mipmaps);
+	void SetCachePath(const std::filesystem::path &path);
+	void SetCacheSize(long long cache_size_gib);
 
 private:
 	wxDirPickerCtrl *output_picker;
@@ -27,4 +29,7 @@ private:
 	wxChoice *max_res_choice;
 	wxChoice *quality_choice;
 	wxChoice *build_mipmaps_choice;
+	wxChoice *working_format_choice;
+	wxDirPickerCtrl *cache_picker;
+	wxChoice *cache_size_choice;
 };
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "planner.hpp"
+#include "filter.hpp"
+#include "texture.hpp"
+
+#include <algorithm>
+#include <format>
+#include <functional>
+
+// GuessFormat only picks formats nvtt writes with the legacy 128 byte header
+static constexpr uint64_t dds_header_bytes = 128;
+
+static std::vector<Paths> FindInputs(const std::filesystem::path &input_dir,
+				     std::vector<std::filesystem::path> &duplicates)
+{
+	std::vector<Paths> paths;
+
+	for (auto entry : std::filesystem::recursive_directory_iterator(input_dir)) {
+		if (!entry.is_regular_file())
+			continue;
+
+		auto input_file = entry.path();
+
+		if (!input_extensions.contains(input_file.extension().string()))
+			continue;
+
+		auto output_file = input_file.lexically_relative(input_dir);
+		output_file.replace_extension("dds");
+
+		auto duplicate = std::any_of(paths.begin(), paths.end(), [&](auto &paths2) {
+			return paths2.output == output_file;
+		});
+
+		if (duplicate) {
+			duplicates.push_back(input_file);
+			continue;
+		}
+
+		paths.push_back({input_file, output_file});
+	}
+
+	return paths;
+}
+
+static int MipmapCount(int width, int height)
+{
+	int levels = 1;
+
+	while (width > 1 || height > 1) {
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+		++levels;
+	}
+
+	return levels;
+}
+
+static uint64_t DdsBytes(nvtt::Format format, int width, int height, int levels)
+{
+	uint64_t bytes = dds_header_bytes;
+
+	for (int i = 0; i < levels; ++i) {
+		bytes += static_cast<uint64_t>(BlocksFor(width)) * BlocksFor(height) *
+			 BlockSize(format);
+
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+
+	return bytes;
+}
+
+// Counts the surfaces alive at the worst point of each path, ignoring nvtt's
+// own scratch memory
+static uint64_t WorkingBytes(const ExportJob &job, const PlannedImage &image)
+{
+	auto source = static_cast<uint64_t>(image.source->width) * image.source->height;
+	auto target = static_cast<uint64_t>(image.width) * image.height;
+	auto chain = job.build_mipmaps ? target * 4 / 3 : target;
+
+	// A filter window of unorm16 rows per level, and the encoded levels
+	// before they are copied behind the header
+	if (image.tiled)
+		return static_cast<uint64_t>(image.source->width) * 8 * 64 + 2 * image.dds_bytes;
+
+	uint64_t working;
+	if (job.working_format == WORKING_FORMAT_FLOAT) {
+		working = std::max(source + target, target + chain) * 16;
+	} else {
+		working = std::max({source * 24, (source + target) * 8, chain * 8 + target * 16});
+
+		if (job.working_format == WORKING_FORMAT_COMPARE)
+			working += chain * 16;
+	}
+
+	return working + image.dds_bytes;
+}
+
+static PlannedImage PlanImage(const ExportJob &job, const std::filesystem::path &input)
+{
+	PlannedImage image;
+
+	std::error_code ec;
+	auto size = std::filesystem::file_size(input, ec);
+	image.input_bytes = ec ? 0 : size;
+	image.modified = std::filesystem::last_write_time(input, ec);
+
+	image.source = ReadImageInfo(input);
+	if (!image.source.has_value())
+		return image;
+
+	auto &source = image.source.value();
+
+	image.format = GuessFormat(input, source.has_alpha);
+	if (!image.format.has_value())
+		return image;
+
+	TargetExtent(source.width, source.height, job.max_res, image.width, image.height);
+
+	image.levels = job.build_mipmaps ? MipmapCount(image.width, image.height) : 1;
+	image.tiled = source.streamable &&
+		      static_cast<uint64_t>(source.width) * source.height > tiled_min_pixels;
+
+	image.dds_bytes = DdsBytes(image.format.value(), image.width, image.height, image.levels);
+	image.working_bytes = WorkingBytes(job, image);
+
+	return image;
+}
+
+std::string CalibrationKey(const ExportJob &job, int workers)
+{
+	return std::format("quality{}-working_format{}-max_res{}-mipmaps{}-threads{}",
+			   static_cast<int>(job.quality), static_cast<int>(job.working_format),
+			   job.max_res, job.build_mipmaps, workers);
+}
+
+using PlannedImages = std::map<std::filesystem::path, const PlannedImage *>;
+
+// The previous entry for input, if the file has not changed since
+static const PlannedImage *FindUnchanged(const PlannedImages &previous,
+					 const std::filesystem::path &input)
+{
+	auto it = previous.find(input);
+	if (it == previous.end())
+		return nullptr;
+
+	std::error_code ec;
+	auto size = std::filesystem::file_size(input, ec);
+	if (ec || size != it->second->input_bytes)
+		return nullptr;
+
+	auto modified = std::filesystem::last_write_time(input, ec);
+	if (ec || modified != it->second->modified)
+		return nullptr;
+
+	return it->second;
+}
+
+ExportPlan PlanExport(const std::vector<ExportJob> &jobs, int workers, uint64_t incremental_bytes,
+		      const Calibration &calibration, const ExportPlan *previous)
+{
+	if (previous && previous->jobs != jobs)
+		previous = nullptr;
+
+	ExportPlan plan;
+	plan.jobs = jobs;
+	plan.workers = std::max(1, workers);
+
+	std::vector<uint64_t> working_bytes;
+	uint64_t archive_bytes = 0;
+	uint64_t float_bytes = 0;
+	double seconds = 0;
+	bool calibrated = true;
+
+	for (size_t j = 0; j < jobs.size(); ++j) {
+		auto &job = jobs[j];
+
+		PlannedImages planned;
+		if (previous) {
+			auto &previous_job = previous->job_plans[j];
+			for (size_t i = 0; i < previous_job.paths.size(); ++i)
+				planned[previous_job.paths[i].input] = &previous_job.images[i];
+		}
+
+		auto &job_plan = plan.job_plans.emplace_back();
+		job_plan.paths = FindInputs(job.input_dir, job_plan.duplicates);
+
+		for (auto &paths : job_plan.paths) {
+			auto unchanged = FindUnchanged(planned, paths.input);
+			auto &image = job_plan.images.emplace_back(
+				unchanged ? *unchanged : PlanImage(job, paths.input));
+
+			job_plan.input_bytes += image.input_bytes;
+			job_plan.dds_bytes += image.dds_bytes;
+
+			if (auto &source = image.source) {
+				job_plan.source_pixels +=
+					static_cast<uint64_t>(source->width) * source->height;
+			}
+
+			working_bytes.push_back(image.working_bytes);
+
+			if (job.working_format == WORKING_FORMAT_FLOAT && !image.tiled)
+				float_bytes += image.working_bytes;
+		}
+
+		plan.dds_bytes += job_plan.dds_bytes;
+
+		// Archive jobs hold every output in memory until the archive is written
+		if (job.format == FORMAT_ARCHIVE)
+			archive_bytes += job_plan.dds_bytes;
+
+		auto rate = calibration.find(CalibrationKey(job, plan.workers));
+		if (rate != calibration.end() && rate->second > 0)
+			seconds += job_plan.source_pixels / 1e6 / rate->second;
+		else
+			calibrated = false;
+	}
+
+	// At worst the largest images are all in flight at once
+	auto in_flight = std::min<size_t>(plan.workers, working_bytes.size());
+	std::partial_sort(working_bytes.begin(), working_bytes.begin() + in_flight,
+			  working_bytes.end(), std::greater{});
+
+	// An incremental entry is never larger than the working set it came from
+	plan.peak_memory = archive_bytes + std::min(incremental_bytes, float_bytes);
+	for (size_t i = 0; i < in_flight; ++i)
+		plan.peak_memory += working_bytes[i];
+
+	if (calibrated)
+		plan.seconds = seconds;
+
+	return plan;
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "common.hpp"
+#include "export_job.hpp"
+#include "image_reader.hpp"
+
+#include <nvtt/nvtt.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+// A float surface of this many texels is already 1 GiB, larger sources are
+// streamed instead of loaded
+static constexpr uint64_t tiled_min_pixels = 8192ull * 8192;
+
+// What exporting one image will produce, worked out from its header alone
+struct PlannedImage {
+	uint64_t input_bytes = 0;
+	std::filesystem::file_time_type modified;
+
+	// Missing if the header could not be read
+	std::optional<ImageInfo> source;
+	std::optional<nvtt::Format> format;
+
+	int width = 0;
+	int height = 0;
+	int levels = 0;
+	bool tiled = false;
+
+	uint64_t dds_bytes = 0;
+
+	// Rough peak of one worker's allocations while compressing the image
+	uint64_t working_bytes = 0;
+};
+
+struct JobPlan {
+	std::vector<Paths> paths;
+	std::vector<PlannedImage> images;
+
+	// Inputs skipped because an earlier input has the same output path
+	std::vector<std::filesystem::path> duplicates;
+
+	uint64_t input_bytes = 0;
+	uint64_t source_pixels = 0;
+	uint64_t dds_bytes = 0;
+};
+
+// Everything known about an export before anything is compressed
+struct ExportPlan {
+	std::vector<ExportJob> jobs;
+	std::vector<JobPlan> job_plans;
+
+	int workers = 1;
+
+	uint64_t dds_bytes = 0;
+	uint64_t peak_memory = 0;
+
+	// Missing until an export with the settings of every job has been measured
+	std::optional<double> seconds;
+};
+
+// Source megapixels compressed per second by earlier exports on this
+// machine, by CalibrationKey
+using Calibration = std::map<std::string, double>;
+
+struct CalibrationSample {
+	std::string key;
+	double rate;
+};
+
+std::string CalibrationKey(const ExportJob &job, int workers);
+
+// Inputs are always listed again. With a previous plan of the same jobs, an
+// input whose size and modification time are unchanged keeps its planned
+// entry instead of having its header read again.
+//
+// incremental_bytes is the capacity of the incremental cache, which float
+// jobs fill with entries that outlive the export.
+ExportPlan PlanExport(const std::vector<ExportJob> &jobs, int workers, uint64_t incremental_bytes,
+		      const Calibration &calibration, const ExportPlan *previous = nullptr);
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "texture.hpp"
+
+using namespace std::string_literals;
+
+std::optional<nvtt::Format> GuessFormat(const std::filesystem::path &input, bool has_alpha)
+{
+	auto stem = input.stem().wstring();
+
+	if (stem.ends_with(L"_B")) {
+		return nvtt::Format_BC1;
+	} else if (stem.ends_with(L"_R")) {
+		return nvtt::Format_BC5;
+	} else if (stem.ends_with(L"_I")) {
+		return nvtt::Format_BC3;
+	} else if (stem.ends_with(L"_N")) {
+		return nvtt::Format_BC5;
+	} else if (stem.ends_with(L"_AO")) {
+		return nvtt::Format_BC1;
+	} else if (stem.ends_with(L"_DirtMask")) {
+		return nvtt::Format_BC1;
+	} else if (stem.ends_with(L"_D")) {
+		if (!has_alpha)
+			return nvtt::Format_BC1;
+		else
+			return nvtt::Format_BC3;
+	} else if (stem.ends_with(L"_H")) {
+		return nvtt::Format_BC1;
+	} else if (stem.ends_with(L"_M")) {
+		return nvtt::Format_BC3;
+	} else if (stem.ends_with(L"_L")) {
+		return nvtt::Format_BC3;
+	} else if (stem.ends_with(L"_CoatR")) {
+		return nvtt::Format_BC1;
+	}
+
+	return std::nullopt;
+}
+
+std::optional<nvtt::Format> GuessFormat(const std::filesystem::path &input,
+					const nvtt::Surface &image)
+{
+	return GuessFormat(input, image.alphaMode() != nvtt::AlphaMode_None);
+}
+
+std::string FormatToString(nvtt::Format format)
+{
+	switch (format) {
+	case nvtt::Format_BC1:
+		return "BC1"s;
+	case nvtt::Format_BC1a:
+		return "BC1a"s;
+	case nvtt::Format_BC2:
+		return "BC2"s;
+	case nvtt::Format_BC3:
+		return "BC3"s;
+	case nvtt::Format_BC3_RGBM:
+		return "BC3_RGBM"s;
+	case nvtt::Format_BC3n:
+		return "BC3n"s;
+	case nvtt::Format_BC4:
+		return "BC4"s;
+	case nvtt::Format_BC4S:
+		return "BC4S"s;
+	case nvtt::Format_BC5:
+		return "BC5"s;
+	case nvtt::Format_BC5S:
+		return "BC5S"s;
+	case nvtt::Format_BC7:
+		return "BC7"s;
+	default:
+		return "Unknown"s;
+	}
+}
+
+int BlockSize(nvtt::Format format)
+{
+	switch (format) {
+	case nvtt::Format_BC1:
+	case nvtt::Format_BC1a:
+	case nvtt::Format_BC4:
+	case nvtt::Format_BC4S:
+		return 8;
+	default:
+		return 16;
+	}
+}
+
+int BlocksFor(int texels)
+{
+	return (texels + 3) / 4;
+}
+
+void BuildNextMipmap(nvtt::Surface &image)
+{
+	image.toLinearFromSrgb();
+	image.premultiplyAlpha();
+
+	image.buildNextMipmap(nvtt::MipmapFilter_Kaiser);
+
+	image.demultiplyAlpha();
+	image.toSrgb();
+}
+
+std::vector<nvtt::Surface> BuildMipmapChain(nvtt::Surface image)
+{
+	std::vector<nvtt::Surface> chain;
+	chain.push_back(image);
+
+	while (chain.back().canMakeNextMipmap()) {
+		chain.emplace_back(chain.back());
+		BuildNextMipmap(chain.back());
+	}
+
+	return chain;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <nvtt/nvtt.h>
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct BufferHandler : nvtt::OutputHandler {
+	~BufferHandler() = default;
+
+	void beginImage(int size, int width, int height, int depth, int face, int miplevel) {}
+	void endImage() {}
+
+	bool writeData(const void *data, int size)
+	{
+		// nvtt stops compressing as soon as a write fails
+		if (cancelled && cancelled->load(std::memory_order_relaxed))
+			return false;
+
+		auto data2 = reinterpret_cast<const uint8_t *>(data);
+		buffer.insert(buffer.end(), data2, &data2[size]);
+
+		return true;
+	}
+
+	std::vector<uint8_t> buffer;
+	const std::atomic<bool> *cancelled = nullptr;
+};
+
+// Encodes a block-aligned surface into its BC blocks in row-major order
+using BlockEncoder =
+	std::function<bool(const nvtt::Surface &surface, std::vector<uint8_t> &blocks)>;
+
+std::optional<nvtt::Format> GuessFormat(const std::filesystem::path &input, bool has_alpha);
+std::optional<nvtt::Format> GuessFormat(const std::filesystem::path &input,
+					const nvtt::Surface &image);
+std::string FormatToString(nvtt::Format format);
+
+int BlockSize(nvtt::Format format);
+int BlocksFor(int texels);
+
+void BuildNextMipmap(nvtt::Surface &image);
+std::vector<nvtt::Surface> BuildMipmapChain(nvtt::Surface image);
\ No newline at end of file
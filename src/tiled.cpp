@@ -0,0 +1,103 @@
+#include "tiled.hpp"
+#include "filter.hpp"
+
+#include <algorithm>
+#include <memory>
+
+// Collects one mip level's rows into bands of one block row, encodes each
+// band as it completes and passes every row on to the next level
+struct LevelStage {
+	Image16 band;
+	int height;
+	int rows = 0;
+
+	const BlockEncoder &encode;
+	std::vector<uint8_t> &blocks;
+
+	std::unique_ptr<RowStream> next;
+
+	LevelStage(int width, int height, nvtt::AlphaMode alpha_mode, const BlockEncoder &encode,
+		   std::vector<uint8_t> &blocks)
+		: band{width, 4, alpha_mode}, height{height}, encode{encode}, blocks{blocks}
+	{
+	}
+
+	bool Push(const uint16_t *row)
+	{
+		size_t row_size = static_cast<size_t>(band.width) * 4;
+		auto band_row = rows % 4;
+
+		std::copy(row, row + row_size, &band.texels[band_row * row_size]);
+		++rows;
+
+		if (band_row == 3 || rows == height) {
+			auto encoded = band_row == 3 ? encode(band.ToSurface(), blocks)
+						     : EncodePartial(band_row + 1);
+			if (!encoded)
+				return false;
+		}
+
+		return !next || next->Push(row);
+	}
+
+	// The last band of a level whose height is not a multiple of 4
+	bool EncodePartial(int band_rows)
+	{
+		Image16 partial{band.width, band_rows, band.alpha_mode};
+		std::copy(band.texels.begin(), band.texels.begin() + partial.texels.size(),
+			  partial.texels.begin());
+
+		return encode(partial.ToSurface(), blocks);
+	}
+};
+
+bool EncodeTiled(RowReader &reader, int width, int height, bool build_mipmaps,
+		 const BlockEncoder &encode, std::vector<std::vector<uint8_t>> &levels)
+{
+	std::vector<std::pair<int, int>> extents{{width, height}};
+	while (build_mipmaps && (extents.back().first > 1 || extents.back().second > 1)) {
+		auto [level_width, level_height] = extents.back();
+		extents.push_back({std::max(1, level_width / 2), std::max(1, level_height / 2)});
+	}
+
+	levels.assign(extents.size(), {});
+
+	auto alpha_mode = reader.has_alpha ? nvtt::AlphaMode_Transparency : nvtt::AlphaMode_None;
+
+	// Built from the smallest level up so each stage can feed the next
+	std::vector<std::unique_ptr<LevelStage>> stages(extents.size());
+	for (size_t i = extents.size(); i-- > 0;) {
+		auto [level_width, level_height] = extents[i];
+		stages[i] = std::make_unique<LevelStage>(level_width, level_height, alpha_mode,
+							 encode, levels[i]);
+
+		if (i + 1 < extents.size()) {
+			auto next = stages[i + 1].get();
+			auto sink = [next](const uint16_t *row) { return next->Push(row); };
+
+			stages[i]->next =
+				MakeMipmapStream(level_width, level_height, alpha_mode, sink);
+		}
+	}
+
+	auto top = stages.front().get();
+
+	std::unique_ptr<RowStream> resize;
+	if (width != reader.width || height != reader.height) {
+		auto sink = [top](const uint16_t *row) { return top->Push(row); };
+		resize = MakeResizeStream(reader.width, reader.height, alpha_mode, width, height,
+					  sink);
+	}
+
+	std::vector<uint16_t> row(static_cast<size_t>(reader.width) * 4);
+	for (int y = 0; y < reader.height; ++y) {
+		if (!reader.ReadRow(row.data()))
+			return false;
+
+		if (!(resize ? resize->Push(row.data()) : top->Push(row.data())))
+			return false;
+	}
+
+	return std::all_of(stages.begin(), stages.end(),
+			   [](auto &stage) { return stage->rows == stage->height; });
+}
\ No newline at end of file
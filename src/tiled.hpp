@@ -0,0 +1,14 @@
+#pragma once
+
+#include "image_reader.hpp"
+#include "texture.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Streams reader's rows through resize to width x height, mipmaps and block
+// encoding, in horizontal bands. Only a filter window of rows is held at each
+// level, so memory follows the image width rather than its area. levels gets
+// the blocks of each mip level, the results match the unorm16 working format.
+bool EncodeTiled(RowReader &reader, int width, int height, bool build_mipmaps,
+		 const BlockEncoder &encode, std::vector<std::vector<uint8_t>> &levels);
\ No newline at end of file